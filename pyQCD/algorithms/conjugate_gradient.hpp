@@ -21,6 +21,10 @@
  * Implementation of the conjugate gradient algorithm.
  */
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include <core/qcd_types.hpp>
 #include <fermions/fermion_action.hpp>
 
@@ -44,25 +48,29 @@ namespace pyQCD
     const auto hermitian_rhs = action.apply_hermiticity(rhs);
 
     Fermion solution(layout, ColourVector<Real, Nc>::Zero(), num_spins);
+    // All fermions used within the main loop are allocated up front, and
+    // the operator is applied in-place to avoid allocations per iteration.
+    Fermion Ap(layout, ColourVector<Real, Nc>::Zero(), num_spins);
 
-    auto r = action.apply_hermiticity(action.apply_full(solution));
+    Fermion r(layout, num_spins);
+    action.apply_full(solution, r);
+    action.apply_hermiticity(r, r);
     r = hermitian_rhs - r;
-    auto p = r;
+    Fermion p = r;
 
-    Real prev_residual = dot_fermions(r, r).real();
+    Real prev_residual = norm2(r);
 
     Int final_iterations = max_iterations;
     Real final_residual = tolerance;
 
     for (Int i = 0; i < max_iterations; ++i) {
-      const auto Ap = action.apply_hermiticity(action.apply_full(p));
-
-      const std::complex<Real> alpha = prev_residual / dot_fermions(p, Ap);
+      action.apply_full(p, Ap);
+      action.apply_hermiticity(Ap, Ap);
 
-      solution += alpha * p;
-      r -= alpha * Ap;
+      const std::complex<Real> alpha =
+          prev_residual / std::complex<Real>(dot_fermions(p, Ap));
 
-      const Real current_residual = dot_fermions(r, r).real();
+      const Real current_residual = cg_update_norm2(alpha, p, Ap, solution, r);
       final_residual = std::sqrt(current_residual);
 
       if (final_residual < tolerance) {
@@ -71,7 +79,7 @@ namespace pyQCD
       }
 
       const Real beta = current_residual / prev_residual;
-      p = r + beta * p;
+      xpay(r, beta, p);
       prev_residual = current_residual;
     }
 
@@ -86,52 +94,41 @@ namespace pyQCD
       const LatticeColourVector<Real, Nc>& rhs, const Int max_iterations,
       const Real tolerance)
   {
+    // The Schur complement system is solved on the odd checkerboard, so all
+    // fermions used within the main loop are half-volume. These are
+    // allocated up front, and the operator is applied in-place to avoid
+    // allocations per iteration.
     using Fermion = LatticeColourVector<Real, Nc>;
 
-    const auto& layout = rhs.layout();
-    const auto volume = layout.volume();
-    Int num_spins = rhs.site_size();
+    const CheckerboardLayout odd_layout(rhs.layout(), Parity::Odd);
+    const Int num_spins = rhs.site_size();
 
-    Fermion hermitian_rhs = rhs;
+    fermions::Workspace<Real, Nc> workspace;
 
     // Create preconditioned source
-    hermitian_rhs.segment(volume / 2, volume / 2) -=
-        action.apply_odd_even(
-            action.apply_even_even_inv(rhs)).segment(volume / 2, volume / 2);
-
-    hermitian_rhs = action.apply_hermiticity(hermitian_rhs);
-
-    Fermion p(layout, ColourVector<Real, Nc>::Zero(), num_spins);
+    Fermion r(odd_layout, ColourVector<Real, Nc>::Zero(), num_spins);
+    action.prepare_schur_source(rhs, r, workspace);
+    action.apply_hermiticity(r, r);
 
-    // Invert the even sites as they're easy
-    auto solution = action.apply_even_even_inv(rhs);
+    // The initial guess is zero, so the initial residual is the source
+    Fermion solution_odd(odd_layout, ColourVector<Real, Nc>::Zero(),
+                         num_spins);
+    Fermion p = r;
+    Fermion Ap(odd_layout, ColourVector<Real, Nc>::Zero(), num_spins);
 
-    auto r = action.apply_hermiticity(action.apply_eoprec(solution));
-
-    // Create some views to the odd sites pertaining to the above fermions
-    auto r_odd_view = r.segment(volume / 2, volume / 2);
-    auto p_odd_view = p.segment(volume / 2, volume / 2);
-    auto solution_odd_view = solution.segment(volume / 2, volume / 2);
-
-    r_odd_view = hermitian_rhs.segment(volume / 2, volume / 2) - r_odd_view;
-    p = r;
-
-    Real prev_residual = dot_fermions(r_odd_view, r_odd_view).real();
+    Real prev_residual = norm2(r);
 
     Int final_iterations = max_iterations;
     Real final_residual = tolerance;
 
     for (Int i = 0; i < max_iterations; ++i) {
-      const auto Ap = action.apply_hermiticity(action.apply_eoprec(p));
+      action.apply_schur_hermitian(p, Ap, workspace);
 
-      const auto Ap_odd_view = Ap.segment(volume / 2, volume / 2);
       const std::complex<Real> alpha =
-          prev_residual / dot_fermions(p_odd_view, Ap_odd_view);
-
-      solution_odd_view += alpha * p_odd_view;
-      r_odd_view -= alpha * Ap_odd_view;
+          prev_residual / std::complex<Real>(dot_fermions(p, Ap));
 
-      const Real current_residual = dot_fermions(r_odd_view, r_odd_view).real();
+      const Real current_residual =
+          cg_update_norm2(alpha, p, Ap, solution_odd, r);
       final_residual = std::sqrt(current_residual);
 
       if (final_residual < tolerance) {
@@ -140,18 +137,463 @@ namespace pyQCD
       }
 
       const Real beta = current_residual / prev_residual;
-      p = r + beta * p;
+      xpay(r, beta, p);
       prev_residual = current_residual;
     }
 
     // Reverse preconditioning preparation
-    solution.segment(0, volume / 2) -=
-        action.apply_even_even_inv(
-            action.apply_even_odd(solution)).segment(0, volume / 2);
+    Fermion solution(rhs.layout(), ColourVector<Real, Nc>::Zero(), num_spins);
+    action.reconstruct_schur_solution(rhs, solution_odd, solution, workspace);
 
     return SolutionWrapper<Real, Nc>(std::move(solution), final_residual,
                                      final_iterations);
   }
+
+
+  template <typename Real, int Nc>
+  std::vector<SolutionWrapper<Real, Nc>> conjugate_gradient_multishift(
+      const fermions::Action<Real, Nc>& action,
+      const LatticeColourVector<Real, Nc>& rhs, const std::vector<Real>& shifts,
+      const Int max_iterations, const Real tolerance)
+  {
+    // Solve (D^dagger D + shifts[k]) x_k = rhs for all k simultaneously, using
+    // the fact that the Krylov space generated by D^dagger D is the same for
+    // all shifts. The operator is only applied to the search direction of the
+    // base system, which has the smallest shift, and the solutions to the
+    // other systems are obtained from the same residuals by rescaling (see
+    // B. Jegerlehner, hep-lat/9612014). D^dagger D is computed as the square
+    // of the hermitian operator used by the solvers above.
+    using Fermion = LatticeColourVector<Real, Nc>;
+
+    const auto& layout = rhs.layout();
+    const Int num_spins = rhs.site_size();
+    const auto num_shifts = shifts.size();
+
+    if (num_shifts == 0) {
+      return {};
+    }
+
+    const Real base_shift = *std::min_element(shifts.begin(), shifts.end());
+
+    std::vector<Fermion> solutions(
+        num_shifts, Fermion(layout, ColourVector<Real, Nc>::Zero(), num_spins));
+    std::vector<Fermion> search_dirs(num_shifts, rhs);
+
+    Fermion r = rhs;
+    Fermion p = rhs;
+    Fermion Ap(layout, num_spins);
+    Fermion temp(layout, num_spins);
+
+    // Per-shift rescaling factors zeta at the next, current and previous
+    // iterations
+    std::vector<Real> zeta_next(num_shifts);
+    std::vector<Real> zeta(num_shifts, 1.0), zeta_prev(num_shifts, 1.0);
+    std::vector<Real> residuals(num_shifts);
+    std::vector<Int> iterations(num_shifts, max_iterations);
+    std::vector<bool> converged(num_shifts, false);
+
+    Real prev_residual = norm2(r);
+    Real alpha_prev = 1.0;
+    Real beta = 0.0;
+    Int num_converged = 0;
+
+    for (unsigned int k = 0; k < num_shifts; ++k) {
+      residuals[k] = std::sqrt(prev_residual);
+      if (residuals[k] < tolerance) {
+        converged[k] = true;
+        iterations[k] = 0;
+        ++num_converged;
+      }
+    }
+
+    for (Int i = 0; i < max_iterations and num_converged < num_shifts; ++i) {
+      action.apply_full(p, temp);
+      action.apply_hermiticity(temp, temp);
+      action.apply_full(temp, Ap);
+      action.apply_hermiticity(Ap, Ap);
+      Ap += base_shift * p;
+
+      // The operator is hermitian and positive definite, so this is real
+      const Real alpha = prev_residual / real_inner_product(p, Ap);
+
+      for (unsigned int k = 0; k < num_shifts; ++k) {
+        if (converged[k]) {
+          continue;
+        }
+        const Real shift = shifts[k] - base_shift;
+        zeta_next[k] =
+            zeta[k] * zeta_prev[k] * alpha_prev /
+            (alpha * beta * (zeta_prev[k] - zeta[k]) +
+             zeta_prev[k] * alpha_prev * (1 + shift * alpha));
+        const Real alpha_k = alpha * zeta_next[k] / zeta[k];
+        solutions[k] += alpha_k * search_dirs[k];
+      }
+
+      const Real current_residual = axpy_norm2(-alpha, Ap, r);
+      beta = current_residual / prev_residual;
+      xpay(r, beta, p);
+
+      for (unsigned int k = 0; k < num_shifts; ++k) {
+        if (converged[k]) {
+          continue;
+        }
+
+        residuals[k] = std::abs(zeta_next[k]) * std::sqrt(current_residual);
+
+        if (residuals[k] < tolerance) {
+          converged[k] = true;
+          iterations[k] = i + 1;
+          ++num_converged;
+          continue;
+        }
+
+        const Real ratio = zeta_next[k] / zeta[k];
+        const Real beta_k = beta * ratio * ratio;
+        search_dirs[k] = zeta_next[k] * r + beta_k * search_dirs[k];
+      }
+
+      // Converged shifts are never read again, so all of zeta can be rotated
+      std::swap(zeta_prev, zeta);
+      std::swap(zeta, zeta_next);
+
+      prev_residual = current_residual;
+      alpha_prev = alpha;
+    }
+
+    std::vector<SolutionWrapper<Real, Nc>> ret;
+    ret.reserve(num_shifts);
+    for (unsigned int k = 0; k < num_shifts; ++k) {
+      ret.emplace_back(std::move(solutions[k]), residuals[k], iterations[k]);
+    }
+
+    return ret;
+  }
+
+
+  namespace detail
+  {
+    template <typename Real, int Nc, typename Op>
+    Int block_conjugate_gradient(
+        const Op& apply_operator,
+        const std::vector<LatticeColourVector<Real, Nc>>& rhs,
+        const Int begin, const Int end, const Int max_iterations,
+        const Real tolerance,
+        std::vector<LatticeColourVector<Real, Nc>>& solutions,
+        std::vector<Real>& residuals, std::vector<Int>& iterations)
+    {
+      // Solve A x_k = rhs[k] for all k simultaneously, where A is the
+      // hermitian operator applied to a batch of fermions by apply_operator
+      // and only the elements in [begin, end) of each fermion take part. The
+      // search directions of all systems span a shared Krylov space (see
+      // D. O'Leary, Linear Algebra Appl. 29 (1980) 293). The block of
+      // residuals loses rank as the systems converge, so it is held as R = Q C
+      // with Q orthonormal, and the search directions are built from Q (see
+      // A. Dubrulle, Electron. Trans. Numer. Anal. 12 (2001) 216):
+      //   alpha = (P^dagger A P)^-1
+      //   X -> X + P alpha C
+      //   Q S = Q - A P alpha
+      //   P -> Q + P S^dagger
+      //   C -> S C
+      // The residual of system k is then the norm of column k of C. The
+      // solutions must be zeroed on entry. Returns the number of iterations
+      // performed.
+      using Fermion = LatticeColourVector<Real, Nc>;
+      using Matrix =
+          Eigen::Matrix<std::complex<Real>, Eigen::Dynamic, Eigen::Dynamic>;
+
+      const auto num_rhs = static_cast<long>(rhs.size());
+
+      if (num_rhs == 0) {
+        return 0;
+      }
+
+      std::vector<Fermion> q = rhs;
+      Matrix c = orthonormalise_fermions(q, begin, end);
+
+      Int num_converged = 0;
+      for (long k = 0; k < num_rhs; ++k) {
+        residuals[k] = c.col(k).norm();
+        iterations[k] = max_iterations;
+        if (residuals[k] < tolerance) {
+          iterations[k] = 0;
+          ++num_converged;
+        }
+      }
+
+      std::vector<Fermion> p = q;
+      std::vector<Fermion> Ap = q;
+
+      Int num_iterations = 0;
+
+      while (num_iterations < max_iterations and num_converged < num_rhs) {
+        apply_operator(p, Ap);
+        ++num_iterations;
+
+        const Eigen::FullPivLU<Matrix> pAp_lu(
+            block_dot_fermions(p, Ap, begin, end));
+        const Matrix alpha =
+            pAp_lu.solve(Matrix::Identity(num_rhs, num_rhs));
+        const Matrix alpha_c = alpha * c;
+
+#pragma omp parallel for
+        for (Int n = begin; n < end; ++n) {
+          for (long j = 0; j < num_rhs; ++j) {
+            for (long l = 0; l < num_rhs; ++l) {
+              solutions[j][n] += alpha_c(l, j) * p[l][n];
+              q[j][n] -= alpha(l, j) * Ap[l][n];
+            }
+          }
+        }
+
+        const Matrix s = orthonormalise_fermions(q, begin, end);
+        c = s * c;
+
+        for (long k = 0; k < num_rhs; ++k) {
+          residuals[k] = c.col(k).norm();
+          if (iterations[k] == max_iterations and residuals[k] < tolerance) {
+            iterations[k] = num_iterations;
+            ++num_converged;
+          }
+        }
+
+        // The new search directions are written to Ap, which is no longer
+        // needed, and then swapped into p.
+#pragma omp parallel for
+        for (Int n = begin; n < end; ++n) {
+          for (long j = 0; j < num_rhs; ++j) {
+            Ap[j][n] = q[j][n];
+            for (long l = 0; l < num_rhs; ++l) {
+              Ap[j][n] += std::conj(s(j, l)) * p[l][n];
+            }
+          }
+        }
+
+        std::swap(p, Ap);
+      }
+
+      return num_iterations;
+    }
+
+
+    template <typename Real, typename InnerReal, int Nc, typename Fn>
+    SolutionWrapper<Real, Nc> defect_correction(
+        const fermions::Action<Real, Nc>& action,
+        const LatticeColourVector<Real, Nc>& rhs, const Int max_iterations,
+        const Real tolerance, const Fn& inner_solver)
+    {
+      // Solve D x = rhs by repeatedly solving D e = r in precision InnerReal,
+      // where r = rhs - D x is the current defect, and adding e to x. The
+      // solution and defect are kept in precision Real, and the defect is
+      // recomputed from scratch after each inner solve (a reliable update),
+      // so the accuracy of the final solution isn't limited by InnerReal.
+      using Fermion = LatticeColourVector<Real, Nc>;
+      using InnerFermion = LatticeColourVector<InnerReal, Nc>;
+
+      const auto& layout = rhs.layout();
+      const Int num_spins = rhs.site_size();
+
+      Fermion solution(layout, ColourVector<Real, Nc>::Zero(), num_spins);
+      Fermion residual = rhs;
+      Fermion correction(layout, num_spins);
+      InnerFermion inner_rhs(layout, num_spins);
+
+      Real residual_norm = std::sqrt(norm2(residual));
+      Int total_iterations = 0;
+
+      while (residual_norm >= tolerance and total_iterations < max_iterations) {
+        // Normalise the defect so that the inner solve works with values of
+        // order one, whatever the size of the defect.
+        residual *= 1 / residual_norm;
+        convert_precision(residual, inner_rhs);
+
+        const auto inner_result =
+            inner_solver(inner_rhs, max_iterations - total_iterations);
+        total_iterations += inner_result.num_iterations();
+
+        convert_precision(inner_result.solution(), correction);
+        solution += residual_norm * correction;
+
+        action.apply_full(solution, correction);
+        residual = rhs - correction;
+
+        const Real prev_residual_norm = residual_norm;
+        residual_norm = std::sqrt(norm2(residual));
+
+        if (inner_result.num_iterations() == 0 or
+            residual_norm >= prev_residual_norm) {
+          // The inner solver can't make any further progress
+          break;
+        }
+      }
+
+      return SolutionWrapper<Real, Nc>(std::move(solution), residual_norm,
+                                       total_iterations);
+    }
+  }
+
+
+  // Mixed-precision variants of the above solvers. The outer defect
+  // correction loop runs in precision Real using action, whilst the inner
+  // solves run in precision InnerReal using inner_action, which should be a
+  // lower precision copy of action (e.g. see the converting constructor of
+  // WilsonAction). Each inner solve reduces the defect by a factor of
+  // inner_tolerance. The returned iteration count is the total number of
+  // inner iterations.
+
+  template <typename Real, typename InnerReal, int Nc>
+  SolutionWrapper<Real, Nc> conjugate_gradient_mixed_unprec(
+      const fermions::Action<Real, Nc>& action,
+      const fermions::Action<InnerReal, Nc>& inner_action,
+      const LatticeColourVector<Real, Nc>& rhs, const Int max_iterations,
+      const Real tolerance, const Real inner_tolerance = 1e-4)
+  {
+    const auto inner_solver =
+        [&] (const LatticeColourVector<InnerReal, Nc>& inner_rhs,
+             const Int inner_max_iterations)
+        {
+          return conjugate_gradient_unprec(
+              inner_action, inner_rhs, inner_max_iterations,
+              static_cast<InnerReal>(inner_tolerance));
+        };
+
+    return detail::defect_correction<Real, InnerReal>(
+        action, rhs, max_iterations, tolerance, inner_solver);
+  }
+
+
+  template <typename Real, typename InnerReal, int Nc>
+  SolutionWrapper<Real, Nc> conjugate_gradient_mixed_eoprec(
+      const fermions::Action<Real, Nc>& action,
+      const fermions::Action<InnerReal, Nc>& inner_action,
+      const LatticeColourVector<Real, Nc>& rhs, const Int max_iterations,
+      const Real tolerance, const Real inner_tolerance = 1e-4)
+  {
+    const auto inner_solver =
+        [&] (const LatticeColourVector<InnerReal, Nc>& inner_rhs,
+             const Int inner_max_iterations)
+        {
+          return conjugate_gradient_eoprec(
+              inner_action, inner_rhs, inner_max_iterations,
+              static_cast<InnerReal>(inner_tolerance));
+        };
+
+    return detail::defect_correction<Real, InnerReal>(
+        action, rhs, max_iterations, tolerance, inner_solver);
+  }
+
+
+  // Block variants of the solvers above, which solve for several right-hand
+  // sides (e.g. the spin-colour components of a propagator source) in a
+  // single Krylov space, applying the operator to all systems at once. The
+  // operators and preconditioning are the same as for
+  // conjugate_gradient_unprec and conjugate_gradient_eoprec respectively.
+
+  template <typename Real, int Nc>
+  BlockSolutionWrapper<Real, Nc> conjugate_gradient_block_unprec(
+      const fermions::Action<Real, Nc>& action,
+      const std::vector<LatticeColourVector<Real, Nc>>& rhs,
+      const Int max_iterations, const Real tolerance)
+  {
+    using Fermion = LatticeColourVector<Real, Nc>;
+
+    const auto num_rhs = rhs.size();
+
+    std::vector<Fermion> hermitian_rhs = rhs;
+    std::vector<Fermion> solutions;
+    solutions.reserve(num_rhs);
+
+    for (unsigned int k = 0; k < num_rhs; ++k) {
+      action.apply_hermiticity(hermitian_rhs[k], hermitian_rhs[k]);
+      solutions.emplace_back(rhs[k].layout(), ColourVector<Real, Nc>::Zero(),
+                             rhs[k].site_size());
+    }
+
+    const auto apply_operator =
+        [&] (const std::vector<Fermion>& in, std::vector<Fermion>& out)
+        {
+          action.apply_full(in, out);
+          for (auto& fermion : out) {
+            action.apply_hermiticity(fermion, fermion);
+          }
+        };
+
+    std::vector<Real> residuals(num_rhs);
+    std::vector<Int> iterations(num_rhs);
+    const Int end = num_rhs > 0 ? rhs.front().size() : 0;
+
+    const auto total_iterations = detail::block_conjugate_gradient(
+        apply_operator, hermitian_rhs, 0, end, max_iterations, tolerance,
+        solutions, residuals, iterations);
+
+    return BlockSolutionWrapper<Real, Nc>(
+        std::move(solutions), std::move(residuals), std::move(iterations),
+        total_iterations);
+  }
+
+
+  template <typename Real, int Nc>
+  BlockSolutionWrapper<Real, Nc> conjugate_gradient_block_eoprec(
+      const fermions::Action<Real, Nc>& action,
+      const std::vector<LatticeColourVector<Real, Nc>>& rhs,
+      const Int max_iterations, const Real tolerance)
+  {
+    using Fermion = LatticeColourVector<Real, Nc>;
+
+    const auto num_rhs = rhs.size();
+
+    if (num_rhs == 0) {
+      return BlockSolutionWrapper<Real, Nc>({}, {}, {}, 0);
+    }
+
+    const CheckerboardLayout odd_layout(rhs.front().layout(), Parity::Odd);
+    const Int num_spins = rhs.front().site_size();
+
+    fermions::Workspace<Real, Nc> workspace;
+
+    // Create preconditioned sources on the odd checkerboard
+    std::vector<Fermion> hermitian_rhs;
+    std::vector<Fermion> solutions_odd;
+    hermitian_rhs.reserve(num_rhs);
+    solutions_odd.reserve(num_rhs);
+
+    for (unsigned int k = 0; k < num_rhs; ++k) {
+      hermitian_rhs.emplace_back(odd_layout, ColourVector<Real, Nc>::Zero(),
+                                 num_spins);
+      action.prepare_schur_source(rhs[k], hermitian_rhs[k], workspace);
+      action.apply_hermiticity(hermitian_rhs[k], hermitian_rhs[k]);
+
+      solutions_odd.emplace_back(odd_layout, ColourVector<Real, Nc>::Zero(),
+                                 num_spins);
+    }
+
+    const auto apply_operator =
+        [&] (const std::vector<Fermion>& in, std::vector<Fermion>& out)
+        {
+          action.apply_schur_hermitian(in, out, workspace);
+        };
+
+    std::vector<Real> residuals(num_rhs);
+    std::vector<Int> iterations(num_rhs);
+
+    const auto total_iterations = detail::block_conjugate_gradient(
+        apply_operator, hermitian_rhs, 0, num_spins * odd_layout.volume(),
+        max_iterations, tolerance, solutions_odd, residuals, iterations);
+
+    // Reverse preconditioning preparation
+    std::vector<Fermion> solutions;
+    solutions.reserve(num_rhs);
+
+    for (unsigned int k = 0; k < num_rhs; ++k) {
+      solutions.emplace_back(rhs[k].layout(), ColourVector<Real, Nc>::Zero(),
+                             num_spins);
+      action.reconstruct_schur_solution(rhs[k], solutions_odd[k],
+                                        solutions[k], workspace);
+    }
+
+    return BlockSolutionWrapper<Real, Nc>(
+        std::move(solutions), std::move(residuals), std::move(iterations),
+        total_iterations);
+  }
 }
 
 #endif //PYQCD_CONJUGATE_GRADIENT_HPP
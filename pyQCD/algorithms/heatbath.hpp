@@ -20,7 +20,8 @@
  * Created by Matt Spraggs on 10/02/16.
  *
  * This file contains the functions necessary to update a single gauge link
- * using the pseudo heatbath algorithm.
+ * using the pseudo heatbath algorithm, along with the overrelaxation update
+ * used alongside it.
  */
 
 #include <array>
@@ -98,16 +99,29 @@ namespace pyQCD {
   }
 
   template <typename Real, int Nc>
-  void heatbath_link_update(RandGenerator& rng,
-                            LatticeColourMatrix<Real, Nc> &gauge_field,
-                            const gauge::Action<Real, Nc> &action,
-                            const Int link_index)
+  ColourMatrix<Real, Nc> comp_su2_overrelaxation_mat(
+      const ColourMatrix<Real, Nc>& W, const unsigned int subgroup)
   {
-    // Perform SU(N) heatbath update on the specified lattice link
-    const auto staple = action.compute_staples(gauge_field, link_index);
-    auto& link = gauge_field(link_index / gauge_field.site_size(),
-                             link_index % gauge_field.site_size());
-    const Real beta_prime = action.beta() / Nc;
+    // Compute the overrelaxation update for the given SU(2) subgroup. If the
+    // subgroup part of W is a * V, with V in SU(2), the update is V^dagger^2,
+    // which maps V to V^dagger and leaves Re tr(W), and hence the action,
+    // unchanged.
+    auto A = extract_su2(W, subgroup);
+    const auto sqrt_detA = std::sqrt(A.determinant());
+    if (sqrt_detA.real() < 6.0 * std::numeric_limits<Real>::epsilon()) {
+      return ColourMatrix<Real, Nc>::Identity();
+    }
+    A /= sqrt_detA;
+    return insert_su2<Nc>((A.adjoint() * A.adjoint()).eval(), subgroup);
+  }
+
+  template <typename Real, int Nc>
+  void heatbath_link_update(RandGenerator& rng, ColourMatrix<Real, Nc>& link,
+                            const ColourMatrix<Real, Nc>& staple,
+                            const Real beta)
+  {
+    // Perform SU(N) heatbath update on the given link using its staple
+    const Real beta_prime = beta / Nc;
 
     constexpr int num_subgroups = (Nc * (Nc - 1)) / 2;
 
@@ -118,34 +132,96 @@ namespace pyQCD {
     }
   }
 
+  template <typename Real, int Nc>
+  void overrelaxation_link_update(ColourMatrix<Real, Nc>& link,
+                                  const ColourMatrix<Real, Nc>& staple)
+  {
+    // Perform an SU(N) overrelaxation update on the given link using its
+    // staple. This doesn't change the action, so it moves the field through
+    // configuration space without affecting the equilibrium distribution.
+    constexpr int num_subgroups = (Nc * (Nc - 1)) / 2;
+
+    for (unsigned int subgroup = 0; subgroup < num_subgroups; ++subgroup) {
+      const ColourMatrix<Real, Nc> link_prod = link * staple;
+      link = comp_su2_overrelaxation_mat(link_prod, subgroup) * link;
+    }
+  }
+
+  template <typename Real, int Nc>
+  void heatbath_link_update(RandGenerator& rng,
+                            LatticeColourMatrix<Real, Nc> &gauge_field,
+                            const gauge::Action<Real, Nc> &action,
+                            const Int link_index)
+  {
+    // Perform SU(N) heatbath update on the specified lattice link
+    const auto staple = action.compute_staples(gauge_field, link_index);
+    auto& link = gauge_field(link_index / gauge_field.site_size(),
+                             link_index % gauge_field.site_size());
+    heatbath_link_update(rng, link, staple, action.beta());
+  }
+
 
   template <typename Real, int Nc>
   void heatbath_update(LatticeColourMatrix<Real, Nc>& gauge_field,
                        const gauge::Action<Real, Nc>& action,
-                       const unsigned int num_iter)
+                       const unsigned int num_iter,
+                       RandomWrapper& random_wrapper)
   {
     auto num_links = gauge_field.size();
     auto site_size = gauge_field.site_size();
-    auto& random_wrapper = rng(gauge_field.layout());
     for (unsigned int i = 0; i < num_iter; ++i) {
+      // Each link direction gets its own sweep number
+      const auto sweep = random_wrapper.reserve_sweeps(site_size);
       for (unsigned int link = 0; link < num_links; ++link) {
-        auto& rng = random_wrapper[link / site_size];
+        auto rng = random_wrapper(link / site_size, sweep + link % site_size);
         heatbath_link_update(rng, gauge_field, action, link);
       }
     }
   }
 
 
+  template <typename Real, int Nc>
+  void heatbath_update(LatticeColourMatrix<Real, Nc>& gauge_field,
+                       const gauge::Action<Real, Nc>& action,
+                       const unsigned int num_iter)
+  {
+    // Use the random numbers shared by all lattices of this shape
+    heatbath_update(gauge_field, action, num_iter, rng(gauge_field.layout()));
+  }
+
+
   template <typename Real, int Nc>
   class Heatbath
   {
   public:
-    Heatbath(const Layout& layout, const gauge::Action<Real, Nc>& action);
+    // The update uses the random numbers in rngs, which must outlive the
+    // Heatbath object. Separate Markov chains should use separate
+    // RandomWrapper objects.
+    Heatbath(const Layout& layout, const gauge::Action<Real, Nc>& action,
+             RandomWrapper& rngs);
+    // As above, using the RandomWrapper shared by all lattices with this
+    // layout's shape
+    Heatbath(const Layout& layout, const gauge::Action<Real, Nc>& action)
+      : Heatbath(layout, action, RandomWrapper::instance(layout))
+    {}
+
+    // Each iteration of update performs one heatbath sweep followed by this
+    // many overrelaxation sweeps. The default is zero.
+    unsigned int num_overrelaxation_steps() const
+    { return num_overrelaxation_steps_; }
+    void set_num_overrelaxation_steps(const unsigned int num_steps)
+    { num_overrelaxation_steps_ = num_steps; }
 
     void update(LatticeColourMatrix<Real, Nc>& gauge_field,
                 const unsigned int num_iter);
 
   private:
+    template <typename Fn>
+    void sweep(LatticeColourMatrix<Real, Nc>& gauge_field,
+               LatticeColourMatrix<Real, Nc>& staples,
+               const Fn& link_update) const;
+
+    unsigned int num_overrelaxation_steps_ = 0;
     RandomWrapper* rngs_;
     const gauge::Action<Real, Nc>* action_;
     std::vector<std::vector<Int>> site_partitioning_;
@@ -154,8 +230,9 @@ namespace pyQCD {
 
   template <typename Real, int Nc>
   Heatbath<Real, Nc>::Heatbath(const Layout& layout,
-                               const gauge::Action<Real, Nc>& action)
-      : rngs_(&RandomWrapper::instance(layout)), action_(&action)
+                               const gauge::Action<Real, Nc>& action,
+                               RandomWrapper& rngs)
+      : rngs_(&rngs), action_(&action)
   {
     // Here we partition the sites such that the sites in a given partition
     // form a rhombic lattice with the shortest lattice edge given by
@@ -191,17 +268,53 @@ namespace pyQCD {
                                   const unsigned int num_iter)
   {
     const auto num_dims = gauge_field.site_size();
+    // The links in a partition don't contribute to each other's staples, so
+    // the staples for all links in a partition with a given direction can be
+    // computed before any of these links are updated.
+    LatticeColourMatrix<Real, Nc> staples(gauge_field.layout(), 1);
+    const Real beta = action_->beta();
 
     for (unsigned int it = 0; it < num_iter; ++it) {
-      for (const auto& partition : site_partitioning_) {
-        for (unsigned int mu = 0; mu < num_dims; ++mu) {
+      // Each site is visited once per link direction in each iteration, so
+      // each direction gets its own sweep number
+      const auto sweep_num = rngs_->reserve_sweeps(num_dims);
+      sweep(gauge_field, staples,
+            [&] (ColourMatrix<Real, Nc>& link,
+                 const ColourMatrix<Real, Nc>& staple,
+                 const Int site, const Int mu) {
+              auto rng = (*rngs_)(site, sweep_num + mu);
+              heatbath_link_update(rng, link, staple, beta);
+            });
+
+      for (unsigned int step = 0; step < num_overrelaxation_steps_; ++step) {
+        sweep(gauge_field, staples,
+              [] (ColourMatrix<Real, Nc>& link,
+                  const ColourMatrix<Real, Nc>& staple, const Int, const Int)
+              { overrelaxation_link_update(link, staple); });
+      }
+    }
+  }
+
+
+  template <typename Real, int Nc>
+  template <typename Fn>
+  void Heatbath<Real, Nc>::sweep(LatticeColourMatrix<Real, Nc>& gauge_field,
+                                 LatticeColourMatrix<Real, Nc>& staples,
+                                 const Fn& link_update) const
+  {
+    // Apply link_update(link, staple, site, mu) to every link, one partition
+    // and direction at a time
+    const auto num_dims = gauge_field.site_size();
+    const auto& layout = gauge_field.layout();
+
+    for (const auto& partition : site_partitioning_) {
+      for (unsigned int mu = 0; mu < num_dims; ++mu) {
+        action_->compute_all_staples(gauge_field, staples, mu, partition);
 #pragma omp parallel for
-          for (unsigned int idx = 0; idx < partition.size(); ++idx) {
-            const auto site = partition[idx];
-            auto& rng = (*rngs_)[site];
-              heatbath_link_update(rng, gauge_field, *action_,
-                                   num_dims * site + mu);
-          }
+        for (unsigned int idx = 0; idx < partition.size(); ++idx) {
+          const auto site = partition[idx];
+          const auto x = layout.get_array_index(site);
+          link_update(gauge_field[num_dims * x + mu], staples[x], site, mu);
         }
       }
     }
@@ -21,7 +21,11 @@
  * Helper functions for LatticeColourVector linear algebra.
  */
 
+#include <limits>
+#include <vector>
+
 #include <core/qcd_types.hpp>
+#include <core/reduction.hpp>
 
 
 namespace pyQCD
@@ -29,10 +33,156 @@ namespace pyQCD
   template<typename T, typename U>
   std::complex<Real> dot_fermions(const T& psi, const U& eta)
   {
-    std::complex <Real> ret(0.0, 0.0);
-    for (Int i = 0; i < psi.size(); ++i) {
-      ret += psi[i].dot(eta[i]);
+    return inner_product(psi, eta);
+  }
+
+
+  // Fused update kernels. Each makes a single pass over the supplied fermions,
+  // which may be Lattice objects or views (and, for read-only arguments,
+  // expressions). Kernels returning a norm use the deterministic reductions
+  // in core/reduction.hpp.
+
+  template <typename Scalar, typename T, typename U>
+  void axpy(const Scalar& a, const T& x, U& y)
+  {
+    // Compute y += a * x
+    const Int size = lattice_obj_size(y);
+
+#pragma omp parallel for
+    for (Int i = 0; i < size; ++i) {
+      y[i] += a * detail::eval(i, x);
     }
+  }
+
+
+  template <typename Scalar, typename T, typename U>
+  void xpay(const T& x, const Scalar& a, U& y)
+  {
+    // Compute y = x + a * y
+    const Int size = lattice_obj_size(y);
+
+#pragma omp parallel for
+    for (Int i = 0; i < size; ++i) {
+      y[i] = detail::eval(i, x) + a * y[i];
+    }
+  }
+
+
+  template <typename Scalar, typename T, typename U>
+  Real axpy_norm2(const Scalar& a, const T& x, U& y)
+  {
+    // Compute y += a * x and return |y|^2
+    return detail::blocked_reduce(
+        lattice_obj_size(y), Real(0.0),
+        [&] (Real& acc, const Int begin, const Int end) {
+          for (Int i = begin; i < end; ++i) {
+            y[i] += a * detail::eval(i, x);
+            acc += y[i].squaredNorm();
+          }
+        });
+  }
+
+
+  template <typename Scalar, typename T, typename U, typename V, typename W>
+  Real cg_update_norm2(const Scalar& alpha, const T& p, const U& Ap,
+                       V& solution, W& residual)
+  {
+    // Compute the conjugate gradient updates
+    //   solution += alpha * p
+    //   residual -= alpha * Ap
+    // and return |residual|^2
+    return detail::blocked_reduce(
+        lattice_obj_size(residual), Real(0.0),
+        [&] (Real& acc, const Int begin, const Int end) {
+          for (Int i = begin; i < end; ++i) {
+            solution[i] += alpha * detail::eval(i, p);
+            residual[i] -= alpha * detail::eval(i, Ap);
+            acc += residual[i].squaredNorm();
+          }
+        });
+  }
+
+
+  template <typename Real, int Nc>
+  Eigen::Matrix<std::complex<Real>, Eigen::Dynamic, Eigen::Dynamic>
+  block_dot_fermions(const std::vector<LatticeColourVector<Real, Nc>>& psi,
+                     const std::vector<LatticeColourVector<Real, Nc>>& eta,
+                     const Int begin, const Int end)
+  {
+    // Compute the matrix of inner products psi[i]^dagger eta[j] over the
+    // elements in [begin, end) in a single pass over the fermions.
+    using Matrix =
+        Eigen::Matrix<std::complex<Real>, Eigen::Dynamic, Eigen::Dynamic>;
+    const auto rows = static_cast<long>(psi.size());
+    const auto cols = static_cast<long>(eta.size());
+
+    return detail::blocked_reduce(
+        end - begin, Matrix(Matrix::Zero(rows, cols)),
+        [&] (Matrix& acc, const Int block_begin, const Int block_end) {
+          for (Int n = begin + block_begin; n < begin + block_end; ++n) {
+            for (long i = 0; i < rows; ++i) {
+              for (long j = 0; j < cols; ++j) {
+                acc(i, j) += psi[i][n].dot(eta[j][n]);
+              }
+            }
+          }
+        });
+  }
+
+
+  template <typename Real, int Nc>
+  Eigen::Matrix<std::complex<Real>, Eigen::Dynamic, Eigen::Dynamic>
+  orthonormalise_fermions(std::vector<LatticeColourVector<Real, Nc>>& psi,
+                          const Int begin, const Int end)
+  {
+    // Replace psi with an orthonormal basis Q over the elements in
+    // [begin, end), returning the matrix S such that psi = Q S on entry.
+    // Each pass diagonalises the Gram matrix psi^dagger psi. A second pass
+    // restores orthogonality lost to rounding when psi is ill-conditioned,
+    // which also turns any numerically dependent vectors into new orthonormal
+    // directions, so Q always has full rank.
+    using Matrix =
+        Eigen::Matrix<std::complex<Real>, Eigen::Dynamic, Eigen::Dynamic>;
+    using Vector = Eigen::Matrix<Real, Eigen::Dynamic, 1>;
+
+    const auto size = static_cast<long>(psi.size());
+    Matrix ret = Matrix::Identity(size, size);
+
+    for (unsigned int pass = 0; pass < 2; ++pass) {
+      const Eigen::SelfAdjointEigenSolver<Matrix> eigen_solver(
+          block_dot_fermions(psi, psi, begin, end));
+      const Matrix& vectors = eigen_solver.eigenvectors();
+      // Clamp the eigenvalues to avoid dividing by zero
+      const Real floor = std::numeric_limits<Real>::min() +
+          eigen_solver.eigenvalues().maxCoeff() *
+          std::numeric_limits<Real>::epsilon() *
+          std::numeric_limits<Real>::epsilon();
+      const Vector roots =
+          eigen_solver.eigenvalues().cwiseMax(floor).cwiseSqrt();
+
+      // psi -> psi V Lambda^(-1/2), S -> Lambda^(1/2) V^dagger S
+      const Matrix transform = vectors * roots.cwiseInverse().asDiagonal();
+      ret = roots.asDiagonal() * vectors.adjoint() * ret;
+
+#pragma omp parallel
+      {
+        std::vector<ColourVector<Real, Nc>> site_values(size);
+
+#pragma omp for
+        for (Int n = begin; n < end; ++n) {
+          for (long j = 0; j < size; ++j) {
+            site_values[j] = psi[j][n];
+          }
+          for (long j = 0; j < size; ++j) {
+            psi[j][n] = transform(0, j) * site_values[0];
+            for (long l = 1; l < size; ++l) {
+              psi[j][n] += transform(l, j) * site_values[l];
+            }
+          }
+        }
+      }
+    }
+
     return ret;
   }
 }
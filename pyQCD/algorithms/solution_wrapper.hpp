@@ -21,6 +21,8 @@
  * Wrapper for solution produced by iterative solver algorithms.
  */
 
+#include <vector>
+
 #include <core/qcd_types.hpp>
 
 
@@ -45,6 +47,42 @@ namespace pyQCD
     Real tolerance_;
     Int num_iterations_;
   };
+
+
+  template <typename Real, int Nc>
+  class BlockSolutionWrapper
+  {
+    // Wrapper for the solutions produced by block solvers, which solve for
+    // several right-hand sides at once. Each solution has its own final
+    // residual and the number of iterations it took to converge, whilst
+    // num_iterations() gives the number of iterations of the block solver.
+  public:
+    BlockSolutionWrapper(std::vector<LatticeColourVector<Real, Nc>> solutions,
+                         std::vector<Real> tolerances,
+                         std::vector<Int> num_iterations,
+                         const Int total_iterations)
+      : solutions_(std::move(solutions)), tolerances_(std::move(tolerances)),
+        num_iterations_(std::move(num_iterations)),
+        total_iterations_(total_iterations)
+    { }
+
+    unsigned int num_solutions() const { return solutions_.size(); }
+
+    const std::vector<LatticeColourVector<Real, Nc>>& solutions() const
+    { return solutions_; }
+    const LatticeColourVector<Real, Nc>& solution(const unsigned int i) const
+    { return solutions_[i]; }
+    Real tolerance(const unsigned int i) const { return tolerances_[i]; }
+    Int num_iterations(const unsigned int i) const
+    { return num_iterations_[i]; }
+    Int num_iterations() const { return total_iterations_; }
+
+  private:
+    std::vector<LatticeColourVector<Real, Nc>> solutions_;
+    std::vector<Real> tolerances_;
+    std::vector<Int> num_iterations_;
+    Int total_iterations_;
+  };
 }
 
 #endif //PYQCD_SOLUTION_WRAPPER_HPP
@@ -18,42 +18,113 @@
  *
  * Created by Matt Spraggs on 27/01/17.
  *
- * Defined allocator for use with std::vector to enforce 16 byte alignment.
+ * Defined allocator for use with std::vector to enforce alignment of lattice
+ * data (64 bytes by default, i.e. a cache line and an AVX-512 register).
+ *
+ * Buffers larger than a huge page are aligned to the huge page size and, where
+ * the platform supports it, marked as eligible for transparent huge pages.
+ * Each allocation is also touched in parallel using the same static OpenMP
+ * schedule as the loops over lattice elements, so that on NUMA systems each
+ * page is placed on the socket of the thread that will later work on it.
  */
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <new>
+
+#include <sys/mman.h>
 
 
 namespace pyQCD
 {
   namespace detail
   {
-    template <typename T>
-    class aligned_allocator : public std::allocator<T>
+    constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+
+    template <typename T, std::size_t Alignment = 64>
+    class aligned_allocator
     {
+      static_assert(Alignment >= alignof(T),
+                    "Alignment must be at least that of the allocated type");
+      static_assert((Alignment & (Alignment - 1)) == 0,
+                    "Alignment must be a power of two");
+
     public:
-      using size_type       = typename std::allocator<T>::size_type;
-      using difference_type = typename std::allocator<T>::difference_type;
-      using pointer         = typename std::allocator<T>::pointer;
-      using const_pointer   = typename std::allocator<T>::const_pointer;
-      using reference       = typename std::allocator<T>::reference;
-      using const_reference = typename std::allocator<T>::const_reference;
+      using value_type      = T;
+      using size_type       = std::size_t;
+      using difference_type = std::ptrdiff_t;
+      using pointer         = T*;
+      using const_pointer   = const T*;
+      using reference       = T&;
+      using const_reference = const T&;
 
       template <typename U>
-      struct rebind { typedef aligned_allocator<U> other; };
+      struct rebind { typedef aligned_allocator<U, Alignment> other; };
 
-      using std::allocator<T>::allocator;
+      aligned_allocator() = default;
+      template <typename U>
+      aligned_allocator(const aligned_allocator<U, Alignment>&) {}
 
-      pointer allocate(size_type num, const void* = nullptr)
-      {
-        return new T[num + alignof(T)];
-      }
+      pointer allocate(size_type num, const void* = nullptr);
 
       void deallocate(pointer ptr, size_type)
       {
-        delete[] ptr;
+        std::free(ptr);
       }
     };
+
+
+    template <typename T, std::size_t Alignment>
+    typename aligned_allocator<T, Alignment>::pointer
+    aligned_allocator<T, Alignment>::allocate(size_type num, const void*)
+    {
+      const std::size_t num_bytes = num * sizeof(T);
+      const bool use_huge_pages = num_bytes >= huge_page_size;
+      const std::size_t alignment =
+          use_huge_pages ? std::max(Alignment, huge_page_size) : Alignment;
+
+      void* ptr = nullptr;
+      if (posix_memalign(&ptr, std::max(alignment, sizeof(void*)),
+                         num_bytes) != 0) {
+        throw std::bad_alloc();
+      }
+
+#ifdef MADV_HUGEPAGE
+      if (use_huge_pages) {
+        // This is only advice, so failure isn't an error.
+        madvise(ptr, num_bytes, MADV_HUGEPAGE);
+      }
+#endif
+
+      // First touch. The chunks here match those of a statically scheduled
+      // parallel loop over the elements. Small buffers aren't worth the cost
+      // of a parallel region, so their pages are left to be placed by
+      // whichever thread first writes to them.
+      if (use_huge_pages) {
+        char* bytes = static_cast<char*>(ptr);
+#pragma omp parallel for schedule(static)
+        for (size_type i = 0; i < num; ++i) {
+          std::memset(bytes + i * sizeof(T), 0, sizeof(T));
+        }
+      }
+
+      return static_cast<pointer>(ptr);
+    }
+
+
+    template <typename T, typename U, std::size_t Alignment>
+    bool operator==(const aligned_allocator<T, Alignment>&,
+                    const aligned_allocator<U, Alignment>&)
+    { return true; }
+
+    template <typename T, typename U, std::size_t Alignment>
+    bool operator!=(const aligned_allocator<T, Alignment>&,
+                    const aligned_allocator<U, Alignment>&)
+    { return false; }
   }
 }
 
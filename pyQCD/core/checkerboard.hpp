@@ -0,0 +1,88 @@
+#ifndef PYQCD_CHECKERBOARD_HPP
+#define PYQCD_CHECKERBOARD_HPP
+
+/*
+ * This file is part of pyQCD.
+ *
+ * pyQCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * pyQCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *
+ * Functions for moving data between full-volume lattices and half-volume
+ * lattices defined on a CheckerboardLayout.
+ */
+
+#include <stdexcept>
+
+#include "lattice.hpp"
+
+
+namespace pyQCD
+{
+  template <typename T>
+  const CheckerboardLayout& checkerboard_layout(const Lattice<T>& lattice)
+  {
+    // Return the layout of the supplied lattice, which must be a
+    // CheckerboardLayout
+    const auto layout =
+        dynamic_cast<const CheckerboardLayout*>(&lattice.layout());
+    if (layout == nullptr) {
+      throw std::invalid_argument(
+          "Lattice must be defined on a CheckerboardLayout");
+    }
+    return *layout;
+  }
+
+
+  template <typename T>
+  void extract_checkerboard(const Lattice<T>& full, Lattice<T>& checkerboard)
+  {
+    // Copy the sites of full with the parity of checkerboard into
+    // checkerboard
+    const auto& layout = checkerboard_layout(checkerboard);
+    const auto& full_layout = full.layout();
+    const Int site_size = full.site_size();
+    const Int volume = layout.volume();
+
+#pragma omp parallel for
+    for (Int i = 0; i < volume; ++i) {
+      const Int full_index =
+          full_layout.get_array_index(layout.get_site_index(i));
+      for (Int s = 0; s < site_size; ++s) {
+        checkerboard[site_size * i + s] = full[site_size * full_index + s];
+      }
+    }
+  }
+
+
+  template <typename T>
+  void insert_checkerboard(const Lattice<T>& checkerboard, Lattice<T>& full)
+  {
+    // Copy checkerboard into the sites of full with the same parity, leaving
+    // the remaining sites of full untouched
+    const auto& layout = checkerboard_layout(checkerboard);
+    const auto& full_layout = full.layout();
+    const Int site_size = full.site_size();
+    const Int volume = layout.volume();
+
+#pragma omp parallel for
+    for (Int i = 0; i < volume; ++i) {
+      const Int full_index =
+          full_layout.get_array_index(layout.get_site_index(i));
+      for (Int s = 0; s < site_size; ++s) {
+        full[site_size * full_index + s] = checkerboard[site_size * i + s];
+      }
+    }
+  }
+}
+
+#endif //PYQCD_CHECKERBOARD_HPP
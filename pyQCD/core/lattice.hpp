@@ -85,6 +85,16 @@ namespace pyQCD
     template <typename Op, typename... Vals>
     Lattice<T>& operator=(const detail::LatticeExpr<Op, Vals...>& expr)
     {
+      // Expressions that read other sites of this lattice, such as shifts of
+      // it, would see sites that have already been overwritten, so these are
+      // evaluated into a temporary first
+      if (detail::reads_other_elements(expr, this)) {
+        Lattice<T> result(*layout_, site_size_);
+        result = expr;
+        data_.swap(result.data_);
+        return *this;
+      }
+
 #pragma omp parallel for
       for (unsigned int i = 0; i < data_.size(); ++i) {
         data_[i] = detail::eval(i, expr);
@@ -131,6 +141,12 @@ namespace pyQCD
   template <typename U>\
   Lattice<T>& Lattice<T>::operator op ## =(const U& rhs)\
   {\
+    if (detail::reads_other_elements(rhs, this)) {\
+      Lattice<T> result(*this);\
+      result op ## = rhs;\
+      data_.swap(result.data_);\
+      return *this;\
+    }\
 _Pragma("omp parallel for")\
     for (unsigned int i = 0; i < data_.size(); ++i) {\
       data_[i] op ## = detail::op_assign_get_rhs(i, rhs);\
@@ -27,6 +27,7 @@
  * LatSim code, see https://github.com/aportelli/LatSim/
  */
 
+#include <initializer_list>
 #include <memory>
 #include <typeinfo>
 #include <type_traits>
@@ -207,6 +208,59 @@ namespace pyQCD
     {
       return value;
     }
+
+
+    // Functions to determine whether an expression reads the object at the
+    // address target, and whether it reads elements of that object other
+    // than the one being evaluated, as shifts do (see lattice_shift.hpp).
+    // Expressions of the latter kind can't be assigned to target in place.
+    template <typename T>
+    bool refers_to(const T& obj, const void* target)
+    { return static_cast<const void*>(&obj) == target; }
+
+    template <typename Op, typename... Vals, std::size_t... Ints>
+    bool refers_to(const LatticeExpr<Op, Vals...>& expr, const void* target,
+                   const Seq<Ints...>)
+    {
+      // Index zero of the expression tuple holds the operator
+      for (const bool refers : {refers_to(std::get<Ints>(expr), target)...}) {
+        if (refers) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    template <typename Op, typename... Vals>
+    bool refers_to(const LatticeExpr<Op, Vals...>& expr, const void* target)
+    {
+      return refers_to(expr, target,
+                       make_int_seq<sizeof...(Vals) + 1>());
+    }
+
+    template <typename T>
+    bool reads_other_elements(const T&, const void*) { return false; }
+
+    template <typename Op, typename... Vals, std::size_t... Ints>
+    bool reads_other_elements(const LatticeExpr<Op, Vals...>& expr,
+                              const void* target, const Seq<Ints...>)
+    {
+      for (const bool reads :
+           {reads_other_elements(std::get<Ints>(expr), target)...}) {
+        if (reads) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    template <typename Op, typename... Vals>
+    bool reads_other_elements(const LatticeExpr<Op, Vals...>& expr,
+                              const void* target)
+    {
+      return reads_other_elements(expr, target,
+                                  make_int_seq<sizeof...(Vals) + 1>());
+    }
   }
 
 
@@ -0,0 +1,185 @@
+#ifndef PYQCD_LATTICE_SHIFT_HPP
+#define PYQCD_LATTICE_SHIFT_HPP
+
+/*
+ * This file is part of pyQCD.
+ *
+ * pyQCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * pyQCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *
+ * Lazy circular shifts of lattice objects for use in the expression templates
+ * in lattice_expr.hpp. The expression shift(psi, mu, 1) evaluates to
+ * psi(x + mu) at site x, so stencils such as
+ *
+ *   result = U_mu * shift(psi, mu, 1);
+ *
+ * are evaluated in a single pass without creating a shifted copy of psi.
+ * Neighbours are looked up in the shift tables of the operand's layout.
+ */
+
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+
+#include "lattice.hpp"
+#include "reduction.hpp"
+
+
+namespace pyQCD
+{
+  namespace detail
+  {
+    // Layout of a lattice object, taken from the first operand of an
+    // expression that has one. Constants have no layout.
+    template <typename T>
+    auto lattice_obj_layout(const T& obj, int) -> decltype(&obj.layout())
+    { return &obj.layout(); }
+
+    template <typename T>
+    const Layout* lattice_obj_layout(const T&, long) { return nullptr; }
+
+    template <typename Op, typename... Vals, std::size_t... Ints>
+    const Layout* lattice_obj_layout(const LatticeExpr<Op, Vals...>& expr,
+                                     const Seq<Ints...>)
+    {
+      // Index zero of the expression tuple holds the operator
+      for (const Layout* layout : {lattice_obj_layout(std::get<Ints>(expr),
+                                                      0)...}) {
+        if (layout != nullptr) {
+          return layout;
+        }
+      }
+      return nullptr;
+    }
+
+    template <typename Op, typename... Vals>
+    const Layout* lattice_obj_layout(const LatticeExpr<Op, Vals...>& expr,
+                                     int)
+    { return lattice_obj_layout(expr, make_int_seq<sizeof...(Vals) + 1>()); }
+
+
+    template <typename T>
+    class LatticeShift : LatticeObj
+    {
+      // Lattice object whose elements at site x are those of the operand at
+      // site x + displacement * dim. The operand is held by reference, as
+      // elsewhere in the expression templates.
+    public:
+      LatticeShift(const T& operand, const Int dim, const int displacement)
+        : operand_(operand), layout_(lattice_obj_layout(operand, 0))
+      {
+        if (layout_ == nullptr) {
+          throw std::invalid_argument("Cannot shift an object without a "
+                                      "layout");
+        }
+        if (dim >= layout_->num_dims()) {
+          throw std::invalid_argument("Invalid shift dimension");
+        }
+        // Odd shifts map a checkerboard onto the opposite parity, which has
+        // no storage in the operand
+        if (displacement % 2 != 0 and
+            dynamic_cast<const CheckerboardLayout*>(layout_) != nullptr) {
+          throw std::invalid_argument("Cannot shift a checkerboard lattice "
+                                      "object by an odd displacement");
+        }
+        size_ = pyQCD::lattice_obj_size(operand);
+        site_size_ = size_ / layout_->volume();
+
+        if (displacement != 0) {
+          const Int magnitude = static_cast<Int>(
+              displacement < 0 ? -displacement : displacement);
+          neighbours_ = layout_->shift_table(magnitude).data();
+          table_stride_ = 2 * layout_->num_dims();
+          table_offset_ = 2 * dim + (displacement < 0 ? 1 : 0);
+        }
+      }
+
+      auto operator[](const unsigned int i) const
+        -> decltype(eval(0, std::declval<const T&>()))
+      {
+        const Int arr_index = i / site_size_;
+        const Int elem = i - site_size_ * arr_index;
+        const Int shifted_index =
+            neighbours_ == nullptr ?
+            arr_index : neighbours_[table_stride_ * arr_index + table_offset_];
+        return eval(site_size_ * shifted_index + elem, operand_);
+      }
+
+      unsigned long size() const { return size_; }
+      const Layout& layout() const { return *layout_; }
+      Int site_size() const { return site_size_; }
+      const T& operand() const { return operand_; }
+
+    private:
+      const T& operand_;
+      const Layout* layout_;
+      unsigned long size_;
+      Int site_size_;
+      // Shift table of the layout, or nullptr for zero displacement
+      const Int* neighbours_ = nullptr;
+      Int table_stride_ = 0, table_offset_ = 0;
+    };
+
+
+    // A shift reads its operand at sites other than the one being evaluated,
+    // so it aliases any object its operand refers to
+    template <typename T>
+    bool refers_to(const LatticeShift<T>& shift, const void* target)
+    { return refers_to(shift.operand(), target); }
+
+    template <typename T>
+    bool reads_other_elements(const LatticeShift<T>& shift,
+                              const void* target)
+    { return refers_to(shift.operand(), target); }
+
+
+    template <typename T>
+    struct Identity
+    {
+      // Used to wrap shifts in a LatticeExpr, so they can be assigned to
+      // Lattice objects like any other expression
+      static T eval(const T& op) { return op; }
+    };
+
+
+    template <typename T>
+    using shift_elem_type =
+      decltype(eval(0, std::declval<const LatticeShift<T>&>()));
+  }
+
+
+  template <typename T,
+    typename std::enable_if<std::is_base_of<LatticeObj, T>::value>::type*
+    = nullptr>
+  auto shift(const T& lattice_obj, const Int dim, const int displacement)
+    -> detail::LatticeExpr<detail::Identity<detail::shift_elem_type<T>>,
+                           detail::LatticeShift<T>>
+  {
+    // Returns an expression that evaluates to lattice_obj(x + displacement *
+    // dim) at site x, with periodic boundary conditions. Displacements of up
+    // to Layout::shift_table's maximum in either direction are supported.
+    // Since lattice_obj is held by reference, the result should be used
+    // within the lifetime of lattice_obj. Assigning the result to a Lattice
+    // that lattice_obj refers to, as in psi = shift(psi, mu, 1), evaluates
+    // it into a temporary first, so costs an extra lattice-sized allocation.
+    // No such check is made for LatticeSegmentView, so views must not be
+    // assigned shifts of the lattice they view.
+    using Ret = detail::LatticeExpr<
+        detail::Identity<detail::shift_elem_type<T>>, detail::LatticeShift<T>>;
+
+    return Ret(detail::Identity<detail::shift_elem_type<T>>(),
+               detail::LatticeShift<T>(lattice_obj, dim, displacement));
+  }
+}
+
+#endif //PYQCD_LATTICE_SHIFT_HPP
@@ -36,8 +36,14 @@
  */
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <stdexcept>
 #include <type_traits>
 #include <vector>
 
@@ -49,17 +55,47 @@ namespace pyQCD
   using Int = unsigned int;
   using Site = std::vector<Int> ;
 
+  namespace detail
+  {
+    struct ShiftTableCache
+    {
+      // Lazily built shift tables for displacements 1 to max_displacement.
+      // Tables are built under the mutex and published through the atomic
+      // pointers, so lookups of existing tables don't need to lock.
+      static constexpr unsigned int max_displacement = 8;
+
+      ShiftTableCache()
+      {
+        for (auto& table : tables) {
+          table.store(nullptr);
+        }
+      }
+
+      std::mutex mutex;
+      std::array<std::atomic<const std::vector<Int>*>, max_displacement> tables;
+      std::vector<std::unique_ptr<const std::vector<Int>>> storage;
+    };
+  }
+
   class Layout
   {
   public:
 
     Layout() = default;
     Layout(const Site& shape)
-      : num_dims_(static_cast<Int>(shape.size())), shape_(shape)
+      : num_dims_(static_cast<Int>(shape.size())), shape_(shape),
+        strides_(shape.size())
     {
       // Constructor create arrays of site/array indices
       volume_ = std::accumulate(shape.begin(), shape.end(), 1u,
         std::multiplies<Int>());
+
+      // Strides of each dimension in the lexicographic site index
+      Int stride = 1;
+      for (int d = num_dims_ - 1; d > -1; --d) {
+        strides_[d] = stride;
+        stride *= shape_[d];
+      }
     }
     virtual ~Layout() = default;
 
@@ -76,18 +112,42 @@ namespace pyQCD
       return partition_sites(neighbour_func, sites);
     }
 
-    // Functions to retrieve array indices and so on.
+    // Functions to retrieve array indices and so on. Indices and coordinates
+    // aren't bounds checked.
     template <typename T,
       typename std::enable_if<not std::is_integral<T>::value>::type* = nullptr>
     inline Int get_array_index(const T& site) const;
     inline Int get_array_index(const Int site_index) const
-    { return array_indices_.at(site_index); }
+    { return array_indices_[site_index]; }
     inline Int get_site_index(const Int array_index) const
-    { return site_indices_.at(array_index); }
+    { return site_indices_[array_index]; }
 
     inline Site compute_site_coords(const Int site_index) const;
+    // As above, but writing the coordinates to the first num_dims() elements
+    // of coords, so that a buffer can be reused
+    template <typename T>
+    inline void compute_site_coords(const Int site_index, T& coords) const;
     template <typename T>
     inline void sanitize_site_coords(T& coords) const;
+    // Returns the site index of the site displacement steps away from the
+    // specified site in dimension dim, applying periodic boundary conditions.
+    // This doesn't require the coordinates of either site.
+    inline Int shift_site_index(const Int site_index, const Int dim,
+                                const int displacement) const;
+
+    // Returns a flat table of the array indices of the neighbours of each
+    // site, arranged as [array_index][2 * dim + dir], where dir = 0 denotes
+    // the site displacement steps forward in dim and dir = 1 the site
+    // displacement steps backward. Each table is built on first use and then
+    // shared between all users of the layout (and its copies). Thread-safe.
+    // Throws std::invalid_argument if the displacement would take any site
+    // off the layout, as odd displacements do on a CheckerboardLayout.
+    inline const std::vector<Int>& shift_table(
+        const Int displacement = 1) const;
+    // As shift_site_index, but using array indices and the unit shift table,
+    // so not usable on a CheckerboardLayout
+    inline Int neighbour_array_index(const Int array_index, const Int dim,
+                                     const int displacement) const;
 
     template <typename T,
       typename std::enable_if<not std::is_integral<T>::value>::type* = nullptr>
@@ -99,14 +159,22 @@ namespace pyQCD
     Int num_dims() const { return num_dims_; }
     const std::vector<Int>& shape() const
     { return shape_; }
+    const std::vector<Int>& strides() const
+    { return strides_; }
 
   protected:
     Int num_dims_, volume_;
-    Site shape_;
+    Site shape_, strides_;
     // array_indices_[site_index] -> array_index
     std::vector<Int> array_indices_;
     // site_indices_[array_index] -> site_index
     std::vector<Int> site_indices_;
+
+  private:
+    const std::vector<Int>& build_shift_table(const Int displacement) const;
+
+    std::shared_ptr<detail::ShiftTableCache> shift_tables_ =
+        std::make_shared<detail::ShiftTableCache>();
   };
 
 
@@ -193,6 +261,134 @@ namespace pyQCD
   };
 
 
+  class VirtualNodeLayout : public Layout
+  {
+    // Layout for SIMD vectorisation. The lattice is divided into a grid of
+    // equally sized sub-lattices, or virtual nodes, with lane_shape
+    // specifying the number of nodes in each dimension. Corresponding sites on
+    // each node are then stored contiguously, so that array_index =
+    // num_lanes * outer_index + lane_index, where outer_index is the
+    // lexicographic index of the site within its node and lane_index is the
+    // lexicographic index of the node itself. Site types from simd_types.hpp
+    // then hold one such group of sites per element, laid out on the
+    // outer_layout.
+  public:
+    VirtualNodeLayout(const Site& shape, const Site& lane_shape)
+      : Layout(shape), lane_shape_(lane_shape),
+        outer_shape_(compute_outer_shape(shape, lane_shape)),
+        outer_layout_(outer_shape_)
+    {
+      num_lanes_ = std::accumulate(lane_shape.begin(), lane_shape.end(), 1u,
+                                   std::multiplies<Int>());
+
+      array_indices_.resize(volume_);
+      site_indices_.resize(volume_);
+
+      for (Int i = 0; i < volume_; ++i) {
+        const auto coords = compute_site_coords(i);
+        Int outer_index = 0;
+        Int lane_index = 0;
+        for (Int d = 0; d < num_dims_; ++d) {
+          outer_index *= outer_shape_[d];
+          outer_index += coords[d] % outer_shape_[d];
+          lane_index *= lane_shape_[d];
+          lane_index += coords[d] / outer_shape_[d];
+        }
+        array_indices_[i] = num_lanes_ * outer_index + lane_index;
+        site_indices_[num_lanes_ * outer_index + lane_index] = i;
+      }
+    }
+
+    Int num_lanes() const { return num_lanes_; }
+    const Site& lane_shape() const { return lane_shape_; }
+    const Site& outer_shape() const { return outer_shape_; }
+    const Layout& outer_layout() const { return outer_layout_; }
+
+  private:
+    static Site compute_outer_shape(const Site& shape, const Site& lane_shape)
+    {
+      if (lane_shape.size() != shape.size()) {
+        throw std::invalid_argument(
+            "VirtualNodeLayout lane shape has wrong number of dimensions");
+      }
+      Site ret(shape.size());
+      for (unsigned d = 0; d < shape.size(); ++d) {
+        if (lane_shape[d] == 0 or shape[d] % lane_shape[d] != 0) {
+          throw std::invalid_argument(
+              "VirtualNodeLayout lane shape must divide lattice shape");
+        }
+        ret[d] = shape[d] / lane_shape[d];
+      }
+      return ret;
+    }
+
+    Int num_lanes_;
+    Site lane_shape_, outer_shape_;
+    LexicoLayout outer_layout_;
+  };
+
+
+  enum class Parity { Even, Odd };
+
+
+  class CheckerboardLayout : public Layout
+  {
+    // Layout for the sites of a single parity of a lattice, used to store
+    // half-volume fields for even-odd preconditioning. Site indices and
+    // coordinates refer to the full lattice, but only sites of the relevant
+    // parity have array indices. These are assigned in lexicographic order.
+    //
+    // Each checkerboard layout owns, or is owned by, the layout of the
+    // opposite parity, so that operators coupling the two parities can
+    // allocate fields on either. The full layout must outlive the
+    // checkerboard layouts.
+  public:
+    CheckerboardLayout(const Layout& full_layout, const Parity parity)
+      : CheckerboardLayout(full_layout, parity, nullptr)
+    {}
+
+    CheckerboardLayout(const CheckerboardLayout&) = delete;
+    CheckerboardLayout& operator=(const CheckerboardLayout&) = delete;
+
+    Parity parity() const { return parity_; }
+    const Layout& full_layout() const { return *full_layout_; }
+    const CheckerboardLayout& opposite() const
+    { return opposite_owner_ ? *opposite_owner_ : *opposite_; }
+
+  private:
+    CheckerboardLayout(const Layout& full_layout, const Parity parity,
+                       const CheckerboardLayout* opposite_owner)
+      : Layout(full_layout.shape()), parity_(parity),
+        full_layout_(&full_layout), opposite_owner_(opposite_owner)
+    {
+      const bool even = parity == Parity::Even;
+      const Int full_volume = volume_;
+
+      array_indices_.assign(full_volume, full_volume);
+      site_indices_.reserve(full_volume / 2 + 1);
+
+      for (Int i = 0; i < full_volume; ++i) {
+        if (is_even_site(i) == even) {
+          array_indices_[i] = static_cast<Int>(site_indices_.size());
+          site_indices_.push_back(i);
+        }
+      }
+
+      volume_ = static_cast<Int>(site_indices_.size());
+
+      if (opposite_owner == nullptr) {
+        opposite_.reset(new CheckerboardLayout(
+            full_layout, even ? Parity::Odd : Parity::Even, this));
+      }
+    }
+
+    Parity parity_;
+    const Layout* full_layout_;
+    const CheckerboardLayout* opposite_owner_;
+    std::unique_ptr<CheckerboardLayout> opposite_;
+  };
+
+
   class PartitionCompare
   {
   public:
@@ -218,23 +414,115 @@ namespace pyQCD
     // Compute the lexicographic index of the specified site and use it to
     // to get the array index (coordinate at site[0] varies slowest, that at
     // site[ndim - 1] varies fastest
-    int site_index = 0;
+    Int site_index = 0;
     for (Int i = 0; i < num_dims_; ++i) {
-      site_index *= shape_[i];
-      site_index += site[i];
+      site_index += strides_[i] * site[i];
     }
-    return array_indices_.at(site_index);
+    return array_indices_[site_index];
   }
 
   inline Site Layout::compute_site_coords(const Int site_index) const
   {
     // Compute the coordinates of the site specified by the given index
-    auto site_index_copy = site_index;
     Site ret(num_dims_);
+    compute_site_coords(site_index, ret);
+    return ret;
+  }
+
+  template <typename T>
+  inline void Layout::compute_site_coords(const Int site_index,
+                                          T& coords) const
+  {
+    auto site_index_copy = site_index;
     for (int i = num_dims_ - 1; i > -1; --i) {
-      ret[i] = mod(site_index_copy, shape_[i]);
+      coords[i] = site_index_copy % shape_[i];
       site_index_copy /= shape_[i];
     }
+  }
+
+  inline Int Layout::shift_site_index(const Int site_index, const Int dim,
+                                      const int displacement) const
+  {
+    const Int extent = shape_[dim];
+    const Int coord = (site_index / strides_[dim]) % extent;
+    const Int shifted_coord = mod(static_cast<int>(coord) + displacement,
+                                  static_cast<int>(extent));
+    return site_index + strides_[dim] * shifted_coord - strides_[dim] * coord;
+  }
+
+  inline const std::vector<Int>& Layout::shift_table(
+      const Int displacement) const
+  {
+    // Fast path for tables that have already been built. Displacement zero
+    // wraps around and so falls through to build_shift_table, which throws.
+    if (displacement - 1 < detail::ShiftTableCache::max_displacement) {
+      const auto table = shift_tables_->tables[displacement - 1].load(
+          std::memory_order_acquire);
+      if (table != nullptr) {
+        return *table;
+      }
+    }
+    return build_shift_table(displacement);
+  }
+
+  inline const std::vector<Int>& Layout::build_shift_table(
+      const Int displacement) const
+  {
+    if (displacement == 0 or
+        displacement > detail::ShiftTableCache::max_displacement) {
+      throw std::invalid_argument("Unsupported shift table displacement");
+    }
+
+    auto& slot = shift_tables_->tables[displacement - 1];
+    std::lock_guard<std::mutex> lock(shift_tables_->mutex);
+    auto table = slot.load(std::memory_order_relaxed);
+    if (table != nullptr) {
+      return *table;
+    }
+
+    const int disp = static_cast<int>(displacement);
+    std::unique_ptr<std::vector<Int>> new_table(
+        new std::vector<Int>(2 * num_dims_ * volume_));
+
+    for (Int array_index = 0; array_index < volume_; ++array_index) {
+      const Int site_index = site_indices_[array_index];
+      for (Int d = 0; d < num_dims_; ++d) {
+        const Int offset = 2 * (num_dims_ * array_index + d);
+        const Int fwd = array_indices_[shift_site_index(site_index, d, disp)];
+        const Int bck = array_indices_[shift_site_index(site_index, d, -disp)];
+        // Sites outside the layout, such as those of the opposite parity in a
+        // CheckerboardLayout, have out-of-range array indices. Never hand
+        // these out as neighbours.
+        if (fwd >= volume_ or bck >= volume_) {
+          throw std::invalid_argument(
+              "Shift table displacement leaves the sites of the layout");
+        }
+        (*new_table)[offset] = fwd;
+        (*new_table)[offset + 1] = bck;
+      }
+    }
+
+    table = new_table.get();
+    shift_tables_->storage.emplace_back(std::move(new_table));
+    slot.store(table, std::memory_order_release);
+
+    return *table;
+  }
+
+  inline Int Layout::neighbour_array_index(const Int array_index,
+                                           const Int dim,
+                                           const int displacement) const
+  {
+    // Larger displacements are made in unit steps, so that only the unit
+    // shift table is needed
+    const auto& table = shift_table(1);
+    const Int dir = displacement < 0 ? 1 : 0;
+    const Int steps = static_cast<Int>(std::abs(displacement));
+
+    Int ret = array_index;
+    for (Int i = 0; i < steps; ++i) {
+      ret = table[2 * (num_dims_ * ret + dim) + dir];
+    }
     return ret;
   }
 
@@ -260,13 +548,17 @@ namespace pyQCD
 
   inline bool Layout::is_even_site(const Int site_index) const
   {
-    return is_even_site(compute_site_coords(site_index));
+    Int sum = 0;
+    for (unsigned i = 0; i < num_dims_; ++i) {
+      sum += (site_index / strides_[i]) % shape_[i];
+    }
+    return sum % 2 == 0;
   }
 
   bool Layout::is_even_array_index(const Int array_index) const
   {
     // Returns true if the site associated with the supplied array index is even
-    return is_even_site(site_indices_.at(array_index));
+    return is_even_site(site_indices_[array_index]);
   }
 }
 
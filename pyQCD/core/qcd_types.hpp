@@ -26,6 +26,8 @@
 
 #include <globals.hpp>
 #include "lattice.hpp"
+#include "lattice_shift.hpp"
+#include "reduction.hpp"
 
 namespace pyQCD {
 
@@ -40,5 +42,29 @@ namespace pyQCD {
 
   template <typename T>
   using SU2Matrix = ColourMatrix<T, 2>;
+
+
+  template <typename RealOut, typename RealIn, int Rows, int Cols>
+  void convert_precision(
+      const Lattice<Eigen::Matrix<std::complex<RealIn>, Rows, Cols>>& in,
+      Lattice<Eigen::Matrix<std::complex<RealOut>, Rows, Cols>>& out)
+  {
+    // Copy in to out, changing the floating point precision of each element.
+    // Both lattices must have the same layout and site size.
+#pragma omp parallel for
+    for (unsigned long i = 0; i < in.size(); ++i) {
+      out[i] = in[i].template cast<std::complex<RealOut>>();
+    }
+  }
+
+  template <typename RealOut, typename RealIn, int Rows, int Cols>
+  Lattice<Eigen::Matrix<std::complex<RealOut>, Rows, Cols>> convert_precision(
+      const Lattice<Eigen::Matrix<std::complex<RealIn>, Rows, Cols>>& in)
+  {
+    Lattice<Eigen::Matrix<std::complex<RealOut>, Rows, Cols>> out(
+        in.layout(), in.site_size());
+    convert_precision(in, out);
+    return out;
+  }
 }
 #endif
\ No newline at end of file
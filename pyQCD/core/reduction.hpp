@@ -0,0 +1,270 @@
+#ifndef PYQCD_REDUCTION_HPP
+#define PYQCD_REDUCTION_HPP
+
+/*
+ * This file is part of pyQCD.
+ *
+ * pyQCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * pyQCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *
+ * Parallel reductions over lattice objects (Lattice instances, views and
+ * expressions). These act as terminals for the expression templates in
+ * lattice_expr.hpp, so an expression such as norm2(rhs - A_x) is evaluated
+ * and reduced element by element without creating a temporary lattice.
+ *
+ * Elements are split into blocks of a fixed size, which are reduced
+ * concurrently, and the partial results are then combined pairwise in a fixed
+ * order. The blocks depend only on the number of elements, so the results are
+ * bitwise identical whatever the number of threads.
+ */
+
+#include <algorithm>
+#include <complex>
+#include <initializer_list>
+#include <type_traits>
+
+#include <globals.hpp>
+
+#include "lattice.hpp"
+
+
+namespace pyQCD
+{
+  namespace detail
+  {
+    // Number of elements reduced serially by each thread before the partial
+    // results are combined.
+    constexpr Int reduction_block_size = 1024;
+
+
+    struct Plus
+    {
+      template <typename T>
+      void operator()(T& acc, const T& value) const { acc += value; }
+    };
+
+    struct Max
+    {
+      template <typename T>
+      void operator()(T& acc, const T& value) const
+      { acc = std::max(acc, value); }
+    };
+
+
+    template <typename T, typename Fn, typename Combine = Plus>
+    T blocked_reduce(const Int size, const T& zero, const Fn& reduce_range,
+                     const Combine& combine = Combine())
+    {
+      // Reduce the elements in [0, size) by calling reduce_range(acc, begin,
+      // end), which should accumulate the contribution from the elements in
+      // [begin, end) into acc. The partial results from each block are then
+      // merged using combine(acc, value).
+      const Int num_blocks =
+          (size + reduction_block_size - 1) / reduction_block_size;
+
+      if (num_blocks == 0) {
+        return zero;
+      }
+
+      aligned_vector<T> partials(num_blocks, zero);
+
+#pragma omp parallel for schedule(static)
+      for (Int block = 0; block < num_blocks; ++block) {
+        const Int begin = block * reduction_block_size;
+        const Int end = std::min(begin + reduction_block_size, size);
+        reduce_range(partials[block], begin, end);
+      }
+
+      for (Int stride = 1; stride < num_blocks; stride *= 2) {
+        for (Int block = 0; block + stride < num_blocks; block += 2 * stride) {
+          combine(partials[block], partials[block + stride]);
+        }
+      }
+
+      return partials[0];
+    }
+
+
+    // Number of elements in a lattice object. Expressions take their size
+    // from their operands, ignoring constants.
+    template <typename T>
+    auto lattice_obj_size(const T& obj, int) -> decltype(Int(obj.size()))
+    { return obj.size(); }
+
+    template <typename T>
+    Int lattice_obj_size(const T&, long) { return 0; }
+
+    template <typename Op, typename... Vals, std::size_t... Ints>
+    Int lattice_obj_size(const LatticeExpr<Op, Vals...>& expr,
+                         const Seq<Ints...>)
+    {
+      // Index zero of the expression tuple holds the operator
+      return std::max({Int(0), lattice_obj_size(std::get<Ints>(expr), 0)...});
+    }
+
+    template <typename Op, typename... Vals>
+    Int lattice_obj_size(const LatticeExpr<Op, Vals...>& expr, int)
+    { return lattice_obj_size(expr, make_int_seq<sizeof...(Vals) + 1>()); }
+
+
+    // Element-wise operations, for both Eigen and scalar types
+    template <typename T, typename U>
+    auto local_inner_product(const T& a, const U& b, int) -> decltype(a.dot(b))
+    { return a.dot(b); }
+
+    template <typename T, typename U>
+    auto local_inner_product(const T& a, const U& b, long)
+      -> decltype(std::conj(a) * b)
+    { return std::conj(a) * b; }
+
+    template <typename T>
+    auto local_norm2(const T& a, int) -> decltype(a.squaredNorm())
+    { return a.squaredNorm(); }
+
+    template <typename T>
+    auto local_norm2(const T& a, long) -> decltype(std::norm(a))
+    { return std::norm(a); }
+
+    template <typename T>
+    auto local_max_abs(const T& a, int) -> decltype(a.cwiseAbs().maxCoeff())
+    { return a.cwiseAbs().maxCoeff(); }
+
+    template <typename T>
+    auto local_max_abs(const T& a, long) -> decltype(std::abs(a))
+    { return std::abs(a); }
+
+    template <typename T>
+    auto make_zero(const T& like, int) -> decltype(T::Zero(like.rows(),
+                                                             like.cols()))
+    { return T::Zero(like.rows(), like.cols()); }
+
+    template <typename T>
+    T make_zero(const T&, long) { return T(0); }
+
+
+    // Type used to accumulate sums of elements of type T. For Eigen
+    // expressions this is the corresponding matrix type.
+    template <typename T, typename = void>
+    struct plain_type
+    {
+      using type = T;
+    };
+
+    template <typename T>
+    struct plain_type<T, typename std::conditional<
+        false, typename T::PlainObject, void>::type>
+    {
+      using type = typename T::PlainObject;
+    };
+  }
+
+
+  template <typename T>
+  Int lattice_obj_size(const T& obj)
+  { return detail::lattice_obj_size(obj, 0); }
+
+
+  template <typename T, typename U>
+  std::complex<Real> inner_product(const T& psi, const U& eta)
+  {
+    // Compute sum_i psi[i]^dagger eta[i]
+    const Int size = std::max(lattice_obj_size(psi), lattice_obj_size(eta));
+
+    return detail::blocked_reduce(
+        size, std::complex<Real>(0.0, 0.0),
+        [&] (std::complex<Real>& acc, const Int begin, const Int end) {
+          for (Int i = begin; i < end; ++i) {
+            acc += std::complex<Real>(detail::local_inner_product(
+                detail::eval(i, psi), detail::eval(i, eta), 0));
+          }
+        });
+  }
+
+
+  template <typename T, typename U>
+  std::complex<Real> inner(const T& psi, const U& eta)
+  { return inner_product(psi, eta); }
+
+
+  template <typename T, typename U>
+  Real real_inner_product(const T& psi, const U& eta)
+  {
+    // Compute Re(sum_i psi[i]^dagger eta[i])
+    const Int size = std::max(lattice_obj_size(psi), lattice_obj_size(eta));
+
+    return detail::blocked_reduce(
+        size, Real(0.0),
+        [&] (Real& acc, const Int begin, const Int end) {
+          for (Int i = begin; i < end; ++i) {
+            acc += std::real(detail::local_inner_product(
+                detail::eval(i, psi), detail::eval(i, eta), 0));
+          }
+        });
+  }
+
+
+  template <typename T>
+  Real norm2(const T& psi)
+  {
+    // Compute sum_i |psi[i]|^2
+    return detail::blocked_reduce(
+        lattice_obj_size(psi), Real(0.0),
+        [&] (Real& acc, const Int begin, const Int end) {
+          for (Int i = begin; i < end; ++i) {
+            acc += detail::local_norm2(detail::eval(i, psi), 0);
+          }
+        });
+  }
+
+
+  template <typename T>
+  auto sum(const T& lattice_obj)
+    -> typename detail::plain_type<
+        typename std::decay<decltype(detail::eval(0, lattice_obj))>::type>::type
+  {
+    // Compute the sum of all elements. The result has the (evaluated) type
+    // of the elements.
+    using Elem = typename detail::plain_type<
+        typename std::decay<decltype(detail::eval(0, lattice_obj))>::type>::type;
+
+    const Int size = lattice_obj_size(lattice_obj);
+    const Elem zero = detail::make_zero(
+        size > 0 ? Elem(detail::eval(0, lattice_obj)) : Elem(), 0);
+
+    return detail::blocked_reduce(
+        size, zero,
+        [&] (Elem& acc, const Int begin, const Int end) {
+          for (Int i = begin; i < end; ++i) {
+            acc += detail::eval(i, lattice_obj);
+          }
+        });
+  }
+
+
+  template <typename T>
+  Real max_abs(const T& psi)
+  {
+    // Compute the largest absolute value of any component of psi
+    return detail::blocked_reduce(
+        lattice_obj_size(psi), Real(0.0),
+        [&] (Real& acc, const Int begin, const Int end) {
+          for (Int i = begin; i < end; ++i) {
+            acc = std::max(
+                acc, Real(detail::local_max_abs(detail::eval(i, psi), 0)));
+          }
+        },
+        detail::Max());
+  }
+}
+
+#endif //PYQCD_REDUCTION_HPP
@@ -0,0 +1,318 @@
+#ifndef PYQCD_SIMD_TYPES_HPP
+#define PYQCD_SIMD_TYPES_HPP
+
+/*
+ * This file is part of pyQCD.
+ *
+ * pyQCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * pyQCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *
+ * This file provides site types for lattices that use the VirtualNodeLayout.
+ * Each element holds the same component for Lanes different lattice sites,
+ * with real and imaginary parts stored in separate arrays. Arithmetic on
+ * these types is written as plain loops over the lanes with no dependencies
+ * between iterations, so the compiler can map each loop onto a handful of
+ * vector instructions.
+ *
+ * These types support the arithmetic required by the expression templates in
+ * lattice_expr.hpp, so Lattice objects of them behave like any other lattice.
+ */
+
+#include <array>
+#include <complex>
+#include <stdexcept>
+
+#include <core/qcd_types.hpp>
+
+
+namespace pyQCD
+{
+  template <typename Real, int Lanes>
+  struct SimdComplex
+  {
+    Real re[Lanes];
+    Real im[Lanes];
+
+    static SimdComplex<Real, Lanes> Zero()
+    {
+      SimdComplex<Real, Lanes> ret;
+      ret.setZero();
+      return ret;
+    }
+
+    void setZero()
+    {
+      for (int l = 0; l < Lanes; ++l) {
+        re[l] = 0.0;
+        im[l] = 0.0;
+      }
+    }
+
+    std::complex<Real> lane(const int l) const
+    { return std::complex<Real>(re[l], im[l]); }
+    void set_lane(const int l, const std::complex<Real>& value)
+    {
+      re[l] = value.real();
+      im[l] = value.imag();
+    }
+
+    // Add a * b to this, lane by lane
+    void fma(const SimdComplex<Real, Lanes>& a,
+             const SimdComplex<Real, Lanes>& b)
+    {
+      for (int l = 0; l < Lanes; ++l) {
+        re[l] += a.re[l] * b.re[l] - a.im[l] * b.im[l];
+        im[l] += a.re[l] * b.im[l] + a.im[l] * b.re[l];
+      }
+    }
+
+    // Add a * x to this, where a is the same for all lanes
+    void add_scaled(const std::complex<Real>& a,
+                    const SimdComplex<Real, Lanes>& x)
+    {
+      const Real a_re = a.real(), a_im = a.imag();
+      for (int l = 0; l < Lanes; ++l) {
+        re[l] += a_re * x.re[l] - a_im * x.im[l];
+        im[l] += a_re * x.im[l] + a_im * x.re[l];
+      }
+    }
+
+    SimdComplex<Real, Lanes>& operator+=(const SimdComplex<Real, Lanes>& rhs)
+    {
+      for (int l = 0; l < Lanes; ++l) {
+        re[l] += rhs.re[l];
+        im[l] += rhs.im[l];
+      }
+      return *this;
+    }
+
+    SimdComplex<Real, Lanes>& operator-=(const SimdComplex<Real, Lanes>& rhs)
+    {
+      for (int l = 0; l < Lanes; ++l) {
+        re[l] -= rhs.re[l];
+        im[l] -= rhs.im[l];
+      }
+      return *this;
+    }
+
+    SimdComplex<Real, Lanes>& operator*=(const std::complex<Real>& rhs)
+    {
+      const Real a = rhs.real(), b = rhs.imag();
+      for (int l = 0; l < Lanes; ++l) {
+        const Real x = re[l];
+        re[l] = a * x - b * im[l];
+        im[l] = a * im[l] + b * x;
+      }
+      return *this;
+    }
+
+    SimdComplex<Real, Lanes>& operator*=(const Real rhs)
+    {
+      for (int l = 0; l < Lanes; ++l) {
+        re[l] *= rhs;
+        im[l] *= rhs;
+      }
+      return *this;
+    }
+  };
+
+
+  template <typename Real, int Nc, int Lanes>
+  struct SimdColourVector
+  {
+    using Scalar = SimdComplex<Real, Lanes>;
+
+    std::array<Scalar, Nc> elems;
+
+    static SimdColourVector<Real, Nc, Lanes> Zero()
+    {
+      SimdColourVector<Real, Nc, Lanes> ret;
+      ret.setZero();
+      return ret;
+    }
+
+    void setZero()
+    {
+      for (auto& elem : elems) {
+        elem.setZero();
+      }
+    }
+
+    Scalar& operator[](const int i) { return elems[i]; }
+    const Scalar& operator[](const int i) const { return elems[i]; }
+
+    void add_scaled(const std::complex<Real>& a,
+                    const SimdColourVector<Real, Nc, Lanes>& x)
+    {
+      for (int i = 0; i < Nc; ++i) {
+        elems[i].add_scaled(a, x.elems[i]);
+      }
+    }
+
+    // Reorder the lanes such that lane l of the result is lane perm[l] of
+    // this vector.
+    SimdColourVector<Real, Nc, Lanes> permute(
+        const std::array<int, Lanes>& perm) const
+    {
+      SimdColourVector<Real, Nc, Lanes> ret;
+      for (int i = 0; i < Nc; ++i) {
+        for (int l = 0; l < Lanes; ++l) {
+          ret.elems[i].re[l] = elems[i].re[perm[l]];
+          ret.elems[i].im[l] = elems[i].im[perm[l]];
+        }
+      }
+      return ret;
+    }
+
+#define PYQCD_SIMD_VECTOR_OP_ASSIGN(op, rhs_type, rhs_elem)\
+    SimdColourVector<Real, Nc, Lanes>& operator op ## =(const rhs_type& rhs)\
+    {\
+      for (int i = 0; i < Nc; ++i) {\
+        elems[i] op ## = rhs_elem;\
+      }\
+      return *this;\
+    }
+
+    PYQCD_SIMD_VECTOR_OP_ASSIGN(+, SimdColourVector, rhs.elems[i])
+    PYQCD_SIMD_VECTOR_OP_ASSIGN(-, SimdColourVector, rhs.elems[i])
+    PYQCD_SIMD_VECTOR_OP_ASSIGN(*, std::complex<Real>, rhs)
+    PYQCD_SIMD_VECTOR_OP_ASSIGN(*, Real, rhs)
+
+#undef PYQCD_SIMD_VECTOR_OP_ASSIGN
+
+    SimdColourVector<Real, Nc, Lanes>& operator/=(const Real rhs)
+    { return *this *= Real(1) / rhs; }
+  };
+
+
+  template <typename Real, int Nc, int Lanes>
+  struct SimdColourMatrix
+  {
+    using Scalar = SimdComplex<Real, Lanes>;
+
+    std::array<Scalar, Nc * Nc> elems;
+
+    Scalar& operator()(const int i, const int j) { return elems[Nc * i + j]; }
+    const Scalar& operator()(const int i, const int j) const
+    { return elems[Nc * i + j]; }
+  };
+
+
+  template <typename Real, int Nc, int Lanes>
+  SimdColourVector<Real, Nc, Lanes> operator+(
+      SimdColourVector<Real, Nc, Lanes> lhs,
+      const SimdColourVector<Real, Nc, Lanes>& rhs)
+  { return lhs += rhs; }
+
+  template <typename Real, int Nc, int Lanes>
+  SimdColourVector<Real, Nc, Lanes> operator-(
+      SimdColourVector<Real, Nc, Lanes> lhs,
+      const SimdColourVector<Real, Nc, Lanes>& rhs)
+  { return lhs -= rhs; }
+
+  template <typename Real, int Nc, int Lanes, typename U>
+  auto operator*(SimdColourVector<Real, Nc, Lanes> lhs, const U& rhs)
+    -> decltype((void) (lhs *= rhs), SimdColourVector<Real, Nc, Lanes>())
+  { return lhs *= rhs; }
+
+  template <typename Real, int Nc, int Lanes, typename U>
+  auto operator*(const U& lhs, SimdColourVector<Real, Nc, Lanes> rhs)
+    -> decltype((void) (rhs *= lhs), SimdColourVector<Real, Nc, Lanes>())
+  { return rhs *= lhs; }
+
+  template <typename Real, int Nc, int Lanes>
+  SimdColourVector<Real, Nc, Lanes> operator/(
+      SimdColourVector<Real, Nc, Lanes> lhs, const Real rhs)
+  { return lhs /= rhs; }
+
+
+  template <typename Real, int Nc, int Lanes>
+  void multiply_add(const SimdColourMatrix<Real, Nc, Lanes>& matrix,
+                    const SimdColourVector<Real, Nc, Lanes>& vector,
+                    SimdColourVector<Real, Nc, Lanes>& result)
+  {
+    // Compute result += matrix * vector
+    for (int i = 0; i < Nc; ++i) {
+      for (int j = 0; j < Nc; ++j) {
+        result[i].fma(matrix(i, j), vector[j]);
+      }
+    }
+  }
+
+
+  template <typename Real, int Nc, int Lanes>
+  using LatticeSimdColourVector = Lattice<SimdColourVector<Real, Nc, Lanes>>;
+  template <typename Real, int Nc, int Lanes>
+  using LatticeSimdColourMatrix = Lattice<SimdColourMatrix<Real, Nc, Lanes>>;
+
+
+  template <typename Real, int Nc, int Lanes>
+  LatticeSimdColourVector<Real, Nc, Lanes> pack_simd(
+      const LatticeColourVector<Real, Nc>& fermion,
+      const VirtualNodeLayout& layout)
+  {
+    // Convert the supplied fermion, which may use any layout, to a vectorised
+    // fermion on the given virtual node layout.
+    if (layout.num_lanes() != Lanes) {
+      throw std::invalid_argument(
+          "Number of SIMD lanes doesn't match VirtualNodeLayout");
+    }
+
+    const Int site_size = fermion.site_size();
+    LatticeSimdColourVector<Real, Nc, Lanes> ret(layout.outer_layout(),
+                                                 site_size);
+
+    for (Int site_index = 0; site_index < layout.volume(); ++site_index) {
+      const Int arr_index = layout.get_array_index(site_index);
+      const Int outer_index = arr_index / Lanes;
+      const int lane = arr_index % Lanes;
+
+      for (Int s = 0; s < site_size; ++s) {
+        const auto& site_elem = fermion(site_index, s);
+        auto& simd_elem = ret[site_size * outer_index + s];
+        for (int c = 0; c < Nc; ++c) {
+          simd_elem[c].set_lane(lane, site_elem[c]);
+        }
+      }
+    }
+
+    return ret;
+  }
+
+
+  template <typename Real, int Nc, int Lanes>
+  void unpack_simd(const LatticeSimdColourVector<Real, Nc, Lanes>& simd_fermion,
+                   const VirtualNodeLayout& layout,
+                   LatticeColourVector<Real, Nc>& fermion)
+  {
+    // Inverse of pack_simd. The destination fermion may use any layout, but
+    // must have the same shape and site size as the source.
+    const Int site_size = simd_fermion.site_size();
+
+    for (Int site_index = 0; site_index < layout.volume(); ++site_index) {
+      const Int arr_index = layout.get_array_index(site_index);
+      const Int outer_index = arr_index / Lanes;
+      const int lane = arr_index % Lanes;
+
+      for (Int s = 0; s < site_size; ++s) {
+        const auto& simd_elem = simd_fermion[site_size * outer_index + s];
+        auto& site_elem = fermion(site_index, s);
+        for (int c = 0; c < Nc; ++c) {
+          site_elem[c] = simd_elem[c].lane(lane);
+        }
+      }
+    }
+  }
+}
+
+#endif //PYQCD_SIMD_TYPES_HPP
@@ -21,8 +21,14 @@
  * Base class for all gauge action types.
  */
 
+#include <algorithm>
+#include <stdexcept>
+
+#include <core/checkerboard.hpp>
 #include <core/qcd_types.hpp>
 
+#include "workspace.hpp"
+
 
 namespace pyQCD
 {
@@ -36,7 +42,7 @@ namespace pyQCD
         : mass_(mass), phases_(pi_frac.size())
       {
         const auto unary_func = [] (const Real pi_angle) {
-          return std::exp(I * pi_angle * (2 * pi));
+          return std::polar(Real(1), static_cast<Real>(2 * pi * pi_angle));
         };
         std::transform(pi_frac.begin(), pi_frac.end(), phases_.begin(),
                        unary_func);
@@ -44,6 +50,9 @@ namespace pyQCD
 
       virtual ~Action() = default;
 
+      Real mass() const { return mass_; }
+      const std::vector<std::complex<Real>>& phases() const { return phases_; }
+
       virtual LatticeColourVector<Real, Nc> apply_full(
           const LatticeColourVector<Real, Nc>& fermion_in) const = 0;
 
@@ -58,9 +67,11 @@ namespace pyQCD
       LatticeColourVector<Real, Nc> apply_eoprec(
           const LatticeColourVector<Real, Nc>& fermion_in) const
       {
-        auto fermion_out = apply_odd_odd(fermion_in);
-        fermion_out -=
-            apply_odd_even(apply_even_even_inv(apply_even_odd(fermion_in)));
+        Workspace<Real, Nc> workspace;
+        LatticeColourVector<Real, Nc> fermion_out(
+            fermion_in.layout(), ColourVector<Real, Nc>::Zero(),
+            fermion_in.site_size());
+        apply_eoprec(fermion_in, fermion_out, workspace);
 
         return fermion_out;
       }
@@ -70,10 +81,426 @@ namespace pyQCD
       virtual LatticeColourVector<Real, Nc> remove_hermiticity(
           const LatticeColourVector<Real, Nc>& fermion) const = 0;
 
+      // In-place variants of the above, which write their result to
+      // fermion_out. fermion_out must share its layout and site size with
+      // fermion_in, and must not be the same object as fermion_in, except
+      // for apply_hermiticity and remove_hermiticity. This applies to all the
+      // in-place functions below, and std::invalid_argument is thrown if it
+      // is violated. The even-odd variants only write to the sites of the
+      // output parity (e.g. the even sites for apply_even_odd) and leave the
+      // remaining sites untouched. The default implementations fall back to
+      // the functions above, so derived classes should override these to
+      // avoid allocating temporaries.
+      virtual void apply_full(const LatticeColourVector<Real, Nc>& fermion_in,
+                              LatticeColourVector<Real, Nc>& fermion_out) const
+      {
+        check_distinct(fermion_in, fermion_out);
+        fermion_out = apply_full(fermion_in);
+      }
+
+      virtual void apply_even_even_inv(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const
+      {
+        check_distinct(fermion_in, fermion_out);
+        assign_even(apply_even_even_inv(fermion_in), fermion_out);
+      }
+      virtual void apply_odd_odd(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const
+      {
+        check_distinct(fermion_in, fermion_out);
+        assign_odd(apply_odd_odd(fermion_in), fermion_out);
+      }
+      virtual void apply_even_odd(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const
+      {
+        check_distinct(fermion_in, fermion_out);
+        assign_even(apply_even_odd(fermion_in), fermion_out);
+      }
+      virtual void apply_odd_even(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const
+      {
+        check_distinct(fermion_in, fermion_out);
+        assign_odd(apply_odd_even(fermion_in), fermion_out);
+      }
+      void apply_eoprec(const LatticeColourVector<Real, Nc>& fermion_in,
+                        LatticeColourVector<Real, Nc>& fermion_out,
+                        Workspace<Real, Nc>& workspace) const;
+
+      // Batched variants of the in-place functions above, which apply the
+      // operator to each fermion in fermions_in. fermions_out must contain
+      // the same number of fermions as fermions_in. The default
+      // implementations apply the operator to each fermion in turn.
+      virtual void apply_full(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+      {
+        for (unsigned int k = 0; k < fermions_in.size(); ++k) {
+          apply_full(fermions_in[k], fermions_out[k]);
+        }
+      }
+      virtual void apply_even_odd(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+      {
+        for (unsigned int k = 0; k < fermions_in.size(); ++k) {
+          apply_even_odd(fermions_in[k], fermions_out[k]);
+        }
+      }
+      virtual void apply_odd_even(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+      {
+        for (unsigned int k = 0; k < fermions_in.size(); ++k) {
+          apply_odd_even(fermions_in[k], fermions_out[k]);
+        }
+      }
+      void apply_eoprec(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+          Workspace<Real, Nc>& workspace) const;
+
+      virtual void apply_hermiticity(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const
+      { fermion_out = apply_hermiticity(fermion_in); }
+      virtual void remove_hermiticity(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const
+      { fermion_out = remove_hermiticity(fermion_in); }
+
+      // Variants of the in-place functions above for half-volume fermions
+      // defined on a CheckerboardLayout. apply_hopping_checkerboard applies
+      // the block of the operator coupling the parity of fermion_in to the
+      // (opposite) parity of fermion_out, i.e. M_eo or M_oe. The default
+      // implementations embed the fermions in full-volume temporaries and
+      // call the even-odd functions above, so derived classes should
+      // override these.
+      virtual void apply_hopping_checkerboard(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const;
+      virtual void apply_hopping_checkerboard(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+      {
+        for (unsigned int k = 0; k < fermions_in.size(); ++k) {
+          apply_hopping_checkerboard(fermions_in[k], fermions_out[k]);
+        }
+      }
+      virtual void apply_even_even_inv_checkerboard(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const
+      {
+        apply_embedded(
+            fermion_in, fermion_out,
+            static_cast<FullOperator>(&Action<Real, Nc>::apply_even_even_inv));
+      }
+      virtual void apply_odd_odd_checkerboard(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const
+      {
+        apply_embedded(
+            fermion_in, fermion_out,
+            static_cast<FullOperator>(&Action<Real, Nc>::apply_odd_odd));
+      }
+
+      // Even-odd preconditioning using checkerboarded fermions. apply_schur
+      // computes the Schur complement M_oo - M_oe M_ee^-1 M_eo on fermions
+      // defined on the odd checkerboard, so unlike apply_eoprec only touches
+      // half-volume fields. prepare_schur_source computes the corresponding
+      // odd source b_o - M_oe M_ee^-1 b_e from the full-volume source b, and
+      // reconstruct_schur_solution combines the solution on the odd sites
+      // with x_e = M_ee^-1 (b_e - M_eo x_o) to give the full-volume solution.
+      // apply_schur_hermitian applies the hermiticity transformation to the
+      // result of apply_schur. The default implementations of these are
+      // built from the checkerboarded blocks above, so derived classes may
+      // override them with fused kernels.
+      virtual void apply_schur(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out,
+          Workspace<Real, Nc>& workspace) const;
+      virtual void apply_schur(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+          Workspace<Real, Nc>& workspace) const;
+      virtual void apply_schur_hermitian(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out,
+          Workspace<Real, Nc>& workspace) const
+      {
+        apply_schur(fermion_in, fermion_out, workspace);
+        apply_hermiticity(fermion_out, fermion_out);
+      }
+      virtual void apply_schur_hermitian(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+          Workspace<Real, Nc>& workspace) const
+      {
+        apply_schur(fermions_in, fermions_out, workspace);
+        for (auto& fermion : fermions_out) {
+          apply_hermiticity(fermion, fermion);
+        }
+      }
+      void prepare_schur_source(const LatticeColourVector<Real, Nc>& rhs,
+                                LatticeColourVector<Real, Nc>& source,
+                                Workspace<Real, Nc>& workspace) const;
+      void reconstruct_schur_solution(
+          const LatticeColourVector<Real, Nc>& rhs,
+          const LatticeColourVector<Real, Nc>& solution_odd,
+          LatticeColourVector<Real, Nc>& solution,
+          Workspace<Real, Nc>& workspace) const;
+
     protected:
+      Action(const Real mass, std::vector<std::complex<Real>> phases)
+        : mass_(mass), phases_(std::move(phases))
+      {}
+
+      // Enforces the no-aliasing rule for in-place functions, for single
+      // fermions and batches alike
+      template <typename T>
+      static void check_distinct(const T& fermion_in, const T& fermion_out)
+      {
+        if (&fermion_in == &fermion_out) {
+          throw std::invalid_argument(
+              "Input and output fermions must be distinct objects");
+        }
+      }
+
+      static void assign_even(const LatticeColourVector<Real, Nc>& src,
+                              LatticeColourVector<Real, Nc>& dest)
+      {
+        const auto half_size = src.size() / 2;
+        std::copy(&src[0], &src[0] + half_size, &dest[0]);
+      }
+      static void assign_odd(const LatticeColourVector<Real, Nc>& src,
+                             LatticeColourVector<Real, Nc>& dest)
+      {
+        const auto half_size = src.size() / 2;
+        std::copy(&src[half_size], &src[0] + src.size(), &dest[half_size]);
+      }
+
+      using FullOperator = void (Action<Real, Nc>::*)(
+          const LatticeColourVector<Real, Nc>&,
+          LatticeColourVector<Real, Nc>&) const;
+
+      void apply_embedded(const LatticeColourVector<Real, Nc>& fermion_in,
+                          LatticeColourVector<Real, Nc>& fermion_out,
+                          const FullOperator op) const;
+
+      static const CheckerboardLayout& odd_checkerboard(
+          const LatticeColourVector<Real, Nc>& fermion);
+
       Real mass_;
       std::vector<std::complex<Real>> phases_;
     };
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::apply_embedded(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out, const FullOperator op) const
+    {
+      // Apply the supplied full-volume operator to the checkerboarded
+      // fermion_in by way of full-volume temporaries.
+      check_distinct(fermion_in, fermion_out);
+      const auto& full_layout = checkerboard_layout(fermion_in).full_layout();
+      LatticeColourVector<Real, Nc> full_in(
+          full_layout, ColourVector<Real, Nc>::Zero(), fermion_in.site_size());
+      LatticeColourVector<Real, Nc> full_out(
+          full_layout, ColourVector<Real, Nc>::Zero(), fermion_out.site_size());
+
+      insert_checkerboard(fermion_in, full_in);
+      (this->*op)(full_in, full_out);
+      extract_checkerboard(full_out, fermion_out);
+    }
+
+
+    template <typename Real, int Nc>
+    const CheckerboardLayout& Action<Real, Nc>::odd_checkerboard(
+        const LatticeColourVector<Real, Nc>& fermion)
+    {
+      const auto& layout = checkerboard_layout(fermion);
+      if (layout.parity() != Parity::Odd) {
+        throw std::invalid_argument(
+            "Fermion must be defined on the odd checkerboard");
+      }
+      return layout;
+    }
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::apply_hopping_checkerboard(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      // M_eo maps odd sites onto even sites and M_oe the converse
+      const auto parity = checkerboard_layout(fermion_in).parity();
+      if (checkerboard_layout(fermion_out).parity() == parity) {
+        throw std::invalid_argument(
+            "Input and output fermions must have opposite parities");
+      }
+
+      const auto op = parity == Parity::Odd ?
+          static_cast<FullOperator>(&Action<Real, Nc>::apply_even_odd) :
+          static_cast<FullOperator>(&Action<Real, Nc>::apply_odd_even);
+      apply_embedded(fermion_in, fermion_out, op);
+    }
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::apply_schur(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out,
+        Workspace<Real, Nc>& workspace) const
+    {
+      // Compute M_oo - M_oe M_ee^-1 M_eo on the odd checkerboard, using two
+      // even and one odd temporary from the supplied workspace.
+      check_distinct(fermion_in, fermion_out);
+      const auto& even_layout = odd_checkerboard(fermion_in).opposite();
+      const Int site_size = fermion_in.site_size();
+      auto& temp0 = workspace.fermion(0, even_layout, site_size);
+      auto& temp1 = workspace.fermion(1, even_layout, site_size);
+      auto& temp2 = workspace.fermion(2, fermion_in);
+
+      apply_hopping_checkerboard(fermion_in, temp0);
+      apply_even_even_inv_checkerboard(temp0, temp1);
+      apply_hopping_checkerboard(temp1, temp2);
+      apply_odd_odd_checkerboard(fermion_in, fermion_out);
+
+      fermion_out -= temp2;
+    }
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::apply_schur(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+        Workspace<Real, Nc>& workspace) const
+    {
+      // As above, but using the batched hopping terms. All fermions must be
+      // defined on the same odd checkerboard.
+      check_distinct(fermions_in, fermions_out);
+      if (fermions_in.empty()) {
+        return;
+      }
+
+      const auto& odd_layout = odd_checkerboard(fermions_in.front());
+      const Int site_size = fermions_in.front().site_size();
+      const auto num_fermions = static_cast<unsigned int>(fermions_in.size());
+      auto& temp0 = workspace.batch(
+          0, odd_layout.opposite(), site_size, num_fermions);
+      auto& temp1 = workspace.batch(
+          1, odd_layout.opposite(), site_size, num_fermions);
+      auto& temp2 = workspace.batch(2, odd_layout, site_size, num_fermions);
+
+      apply_hopping_checkerboard(fermions_in, temp0);
+      for (unsigned int k = 0; k < num_fermions; ++k) {
+        apply_even_even_inv_checkerboard(temp0[k], temp1[k]);
+      }
+      apply_hopping_checkerboard(temp1, temp2);
+
+      for (unsigned int k = 0; k < num_fermions; ++k) {
+        apply_odd_odd_checkerboard(fermions_in[k], fermions_out[k]);
+        fermions_out[k] -= temp2[k];
+      }
+    }
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::prepare_schur_source(
+        const LatticeColourVector<Real, Nc>& rhs,
+        LatticeColourVector<Real, Nc>& source,
+        Workspace<Real, Nc>& workspace) const
+    {
+      const auto& even_layout = odd_checkerboard(source).opposite();
+      const Int site_size = rhs.site_size();
+      auto& rhs_even = workspace.fermion(0, even_layout, site_size);
+      auto& temp = workspace.fermion(1, even_layout, site_size);
+      auto& rhs_odd = workspace.fermion(2, source);
+
+      extract_checkerboard(rhs, rhs_even);
+      extract_checkerboard(rhs, rhs_odd);
+
+      apply_even_even_inv_checkerboard(rhs_even, temp);
+      apply_hopping_checkerboard(temp, source);
+      source = rhs_odd - source;
+    }
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::reconstruct_schur_solution(
+        const LatticeColourVector<Real, Nc>& rhs,
+        const LatticeColourVector<Real, Nc>& solution_odd,
+        LatticeColourVector<Real, Nc>& solution,
+        Workspace<Real, Nc>& workspace) const
+    {
+      const auto& even_layout = odd_checkerboard(solution_odd).opposite();
+      const Int site_size = rhs.site_size();
+      auto& rhs_even = workspace.fermion(0, even_layout, site_size);
+      auto& temp = workspace.fermion(1, even_layout, site_size);
+
+      extract_checkerboard(rhs, rhs_even);
+      apply_hopping_checkerboard(solution_odd, temp);
+      rhs_even -= temp;
+      apply_even_even_inv_checkerboard(rhs_even, temp);
+
+      insert_checkerboard(temp, solution);
+      insert_checkerboard(solution_odd, solution);
+    }
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::apply_eoprec(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out,
+        Workspace<Real, Nc>& workspace) const
+    {
+      // Compute M_oo - M_oe M_ee^-1 M_eo on the odd sites of fermion_in,
+      // using two temporaries from the supplied workspace.
+      check_distinct(fermion_in, fermion_out);
+      auto& temp0 = workspace.fermion(0, fermion_in);
+      auto& temp1 = workspace.fermion(1, fermion_in);
+
+      apply_even_odd(fermion_in, temp0);
+      apply_even_even_inv(temp0, temp1);
+      apply_odd_even(temp1, temp0);
+      apply_odd_odd(fermion_in, fermion_out);
+
+      const auto half_vol = fermion_in.volume() / 2;
+      fermion_out.segment(half_vol, half_vol) -=
+          temp0.segment(half_vol, half_vol);
+    }
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::apply_eoprec(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+        Workspace<Real, Nc>& workspace) const
+    {
+      // As above, but using the batched hopping terms so that derived classes
+      // can share the cost of loading the gauge field across the batch.
+      check_distinct(fermions_in, fermions_out);
+      auto& temp0 = workspace.batch(0, fermions_in);
+      auto& temp1 = workspace.batch(1, fermions_in);
+
+      apply_even_odd(fermions_in, temp0);
+      for (unsigned int k = 0; k < fermions_in.size(); ++k) {
+        apply_even_even_inv(temp0[k], temp1[k]);
+      }
+      apply_odd_even(temp1, temp0);
+
+      for (unsigned int k = 0; k < fermions_in.size(); ++k) {
+        apply_odd_odd(fermions_in[k], fermions_out[k]);
+
+        const auto half_vol = fermions_in[k].volume() / 2;
+        fermions_out[k].segment(half_vol, half_vol) -=
+            temp0[k].segment(half_vol, half_vol);
+      }
+    }
   }
 }
 
@@ -19,8 +19,45 @@
  * Created by Matt Spraggs on 02/02/17.
  *
  * Implementation of 4D hopping matrix.
+ *
+ * Each spin structure supplied to the hopping matrix is factorised into a
+ * projector onto a reduced set of spin components and a corresponding
+ * reconstruction matrix. For Wilson-like (1 -/+ gamma_mu) structures this
+ * reduced set is a two-component half-spinor, so the colour matrix
+ * multiplication only has to be applied to half as many colour vectors.
+ * The Wilson structures -(1 -/+ gamma_mu) / 2 used by WilsonAction in four
+ * dimensions are recognised on construction, and are then applied by a
+ * dedicated kernel in which the projections and reconstructions are
+ * hard-coded as additions and subtractions of spin components. Other spin
+ * structures are applied using tables of the non-zero projection elements.
+ *
+ * For SU(3) gauge fields the links may optionally be stored in a compressed
+ * form, with the full matrices rebuilt inside the hopping kernel. In this case
+ * the boundary phases can't be folded into the links, so they are instead
+ * applied to the half-spinors of the hops that cross the lattice boundary.
+ *
+ * The hopping matrix can also be applied to a batch of fermions at once (e.g.
+ * the columns of a propagator). The sites are then processed in small tiles,
+ * with the tile applied to every fermion in the batch before moving on to the
+ * next one. The links for a tile are therefore read from memory once and then
+ * from cache for the remaining fermions in the batch.
+ *
+ * Half-volume fermions defined on a CheckerboardLayout are also supported. The
+ * neighbours of each site are then looked up in a separate table holding
+ * checkerboard indices, whilst the links are shared with the full-volume
+ * kernels. The checkerboarded kernels accept an epilogue, which is applied to
+ * each output site as soon as its hopping term has been computed. This allows
+ * diagonal terms and spin factors to be folded into a single sweep over the
+ * lattice whilst the site is still in cache.
  */
 
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include <core/checkerboard.hpp>
 #include <core/qcd_types.hpp>
 #include <utils/matrices.hpp>
 
@@ -29,15 +66,364 @@ namespace pyQCD
 {
   namespace fermions
   {
+    template <typename Real>
+    struct SpinProjection
+    {
+      // Rank factorisation of a spin structure, such that
+      //   spin_structure = reconstructor * projector
+      // where projector has shape (rank, num_spins) and reconstructor has
+      // shape (num_spins, rank).
+      SpinMatrix<Real> projector;
+      SpinMatrix<Real> reconstructor;
+    };
+
+
+    template <typename Real>
+    SpinProjection<Real> factorise_spin_structure(
+        const SpinMatrix<Real>& spin_structure)
+    {
+      // Select a maximal set of linearly independent rows of the spin
+      // structure using Gram-Schmidt orthogonalisation. These rows form the
+      // projector, and the reconstruction matrix then expresses each row of the
+      // spin structure in terms of them.
+      const auto num_spins = spin_structure.rows();
+      const Real tolerance = 100 * std::numeric_limits<Real>::epsilon();
+
+      using SpinRow = Eigen::Matrix<std::complex<Real>, 1, Eigen::Dynamic>;
+
+      std::vector<long> selected_rows;
+      std::vector<SpinRow> basis;
+
+      for (long row = 0; row < num_spins; ++row) {
+        SpinRow residual = spin_structure.row(row);
+        for (const auto& basis_row : basis) {
+          residual -= basis_row.dot(residual) * basis_row;
+        }
+        const Real norm = residual.norm();
+        if (norm > tolerance) {
+          basis.push_back(residual / norm);
+          selected_rows.push_back(row);
+        }
+      }
+
+      const auto rank = static_cast<long>(selected_rows.size());
+
+      SpinProjection<Real> ret;
+      ret.projector.resize(rank, num_spins);
+      for (long i = 0; i < rank; ++i) {
+        ret.projector.row(i) = spin_structure.row(selected_rows[i]);
+      }
+
+      const SpinMatrix<Real> gram = ret.projector * ret.projector.adjoint();
+      ret.reconstructor =
+          spin_structure * ret.projector.adjoint() * gram.inverse();
+
+      return ret;
+    }
+
+
+    template <typename Real>
+    struct SpinProjectionTable
+    {
+      // Non-zero element of a projection or reconstruction matrix
+      struct Entry
+      {
+        unsigned int row, col;
+        std::complex<Real> coeff;
+      };
+
+      SpinProjectionTable(const std::vector<SpinMatrix<Real>>& spin_structures,
+                          const unsigned int num_spins);
+
+      unsigned int num_half_spins;
+      // Projector entries are ordered by row and reconstructor entries by
+      // column, so that both can be traversed one half-spin at a time.
+      std::vector<std::vector<Entry>> projector_entries;
+      std::vector<std::vector<Entry>> reconstructor_entries;
+    };
+
+
+    template <typename Real>
+    SpinProjectionTable<Real>::SpinProjectionTable(
+        const std::vector<SpinMatrix<Real>>& spin_structures,
+        const unsigned int num_spins)
+      : num_half_spins(0)
+    {
+      // Factorise each spin structure and store the non-zero elements of the
+      // resulting matrices. All projections are padded to the largest rank so
+      // that every hop can be processed with the same number of half-spins.
+      std::vector<SpinProjection<Real>> projections;
+      projections.reserve(spin_structures.size());
+
+      for (const auto& spin_structure : spin_structures) {
+        projections.push_back(factorise_spin_structure(spin_structure));
+        num_half_spins = std::max(
+            num_half_spins,
+            static_cast<unsigned int>(projections.back().projector.rows()));
+      }
+
+      projector_entries.resize(projections.size());
+      reconstructor_entries.resize(projections.size());
+
+      for (unsigned int i = 0; i < projections.size(); ++i) {
+        const auto& projector = projections[i].projector;
+        const auto& reconstructor = projections[i].reconstructor;
+
+        for (unsigned int a = 0; a < projector.rows(); ++a) {
+          for (unsigned int beta = 0; beta < num_spins; ++beta) {
+            if (projector(a, beta) != std::complex<Real>(0.0, 0.0)) {
+              projector_entries[i].push_back({a, beta, projector(a, beta)});
+            }
+          }
+        }
+        for (unsigned int a = 0; a < reconstructor.cols(); ++a) {
+          for (unsigned int alpha = 0; alpha < num_spins; ++alpha) {
+            if (reconstructor(alpha, a) != std::complex<Real>(0.0, 0.0)) {
+              reconstructor_entries[i].push_back(
+                  {alpha, a, reconstructor(alpha, a)});
+            }
+          }
+        }
+      }
+    }
+
+
+    // Storage format for the links used by the hopping matrix. TwelveReal
+    // stores the first two rows of each link, whilst EightReal stores the
+    // minimal eight parameter representation. Both require SU(3) links. If
+    // any link can't be stored accurately using eight reals (e.g. for a unit
+    // gauge field), TwelveReal is used instead.
+    enum class LinkCompression { None, TwelveReal, EightReal };
+
+
+    // Kernel used to apply the spin structures of the hopping matrix. Table
+    // supports arbitrary spin structures, whilst Wilson is used for the
+    // four-dimensional Wilson spin structures -(1 -/+ gamma_mu) / 2.
+    enum class SpinKernel { Table, Wilson };
+
+
+    namespace detail
+    {
+      template <typename Real, int Nc, LinkCompression Compression>
+      struct LinkCodec
+      {
+        // Fallback for unsupported combinations, which are rejected by the
+        // HoppingMatrix constructor.
+        static constexpr unsigned int size = 0;
+        static void compress(const ColourMatrix<Real, Nc>&, Real*) {}
+        static void reconstruct(const Real*, ColourMatrix<Real, Nc>&) {}
+      };
+
+      template <typename Real>
+      struct LinkCodec<Real, 3, LinkCompression::TwelveReal>
+      {
+        static constexpr unsigned int size = 12;
+        static void compress(const ColourMatrix<Real, 3>& link, Real* data)
+        { compress_su3_12(link, data); }
+        static void reconstruct(const Real* data, ColourMatrix<Real, 3>& link)
+        { link = reconstruct_su3_12<Real>(data); }
+      };
+
+      template <typename Real>
+      struct LinkCodec<Real, 3, LinkCompression::EightReal>
+      {
+        static constexpr unsigned int size = 8;
+        static void compress(const ColourMatrix<Real, 3>& link, Real* data)
+        { compress_su3_8(link, data); }
+        static void reconstruct(const Real* data, ColourMatrix<Real, 3>& link)
+        { link = reconstruct_su3_8<Real>(data); }
+      };
+
+      template <typename Real, int Nc>
+      bool can_compress_links_8(const LatticeColourMatrix<Real, Nc>&)
+      { return false; }
+
+      template <typename Real>
+      bool can_compress_links_8(const LatticeColourMatrix<Real, 3>& links)
+      {
+        for (unsigned long i = 0; i < links.size(); ++i) {
+          if (not can_compress_su3_8(links[i])) {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      template <LinkCompression Compression>
+      using CompressionTag = std::integral_constant<LinkCompression,
+                                                    Compression>;
+
+      template <SpinKernel Kernel>
+      using SpinKernelTag = std::integral_constant<SpinKernel, Kernel>;
+
+      template <typename Real>
+      bool is_wilson_spin_structures(
+          const std::vector<SpinMatrix<Real>>& spin_structures,
+          const unsigned int num_dims)
+      {
+        // Determines whether the spin structures are those of the Wilson
+        // action, -(1 - gamma_mu) / 2 and -(1 + gamma_mu) / 2, in four
+        // dimensions, so that the Wilson kernel can be used.
+        if (num_dims != 4 or spin_structures.size() != 8) {
+          return false;
+        }
+
+        const auto gammas = generate_gamma_matrices<Real>(4);
+        const SpinMatrix<Real> identity = SpinMatrix<Real>::Identity(4, 4);
+        const Real tolerance = 100 * std::numeric_limits<Real>::epsilon();
+
+        for (unsigned int mu = 0; mu < 4; ++mu) {
+          for (unsigned int dir = 0; dir < 2; ++dir) {
+            const auto& spin_structure = spin_structures[2 * mu + dir];
+            if (spin_structure.rows() != 4 or spin_structure.cols() != 4) {
+              return false;
+            }
+            const Real sign = dir == 0 ? -1 : 1;
+            const SpinMatrix<Real> expected =
+                Real(-0.5) * (identity + sign * gammas[mu]);
+            if ((spin_structure - expected).norm() > tolerance) {
+              return false;
+            }
+          }
+        }
+        return true;
+      }
+
+      template <int Re, int Im, typename Real>
+      std::complex<Real> times_unit(const std::complex<Real>& z)
+      {
+        // Multiplies z by Re + i Im, which must be one of 1, -1, i or -i, by
+        // permuting and negating its components
+        return Re != 0 ?
+               std::complex<Real>(Re * z.real(), Re * z.imag()) :
+               std::complex<Real>(-Im * z.imag(), Im * z.real());
+      }
+
+      template <int Re, int Im, typename Vector>
+      void add_times_unit(const Vector& a, const Vector& b, Vector& result)
+      {
+        // result = a + (Re + i Im) b
+        for (int c = 0; c < a.size(); ++c) {
+          result[c] = a[c] + times_unit<Re, Im>(b[c]);
+        }
+      }
+
+      template <int Re, int Im, typename Vector>
+      void accumulate_times_unit(const Vector& a, Vector& result)
+      {
+        // result += (Re + i Im) a
+        for (int c = 0; c < a.size(); ++c) {
+          result[c] += times_unit<Re, Im>(a[c]);
+        }
+      }
+
+      template <int Col0, int Re0, int Im0, int Col1, int Re1, int Im1>
+      struct WilsonProjection
+      {
+        // Projection and reconstruction for the spin structure
+        // (1 - Sign * gamma_mu), where, in the basis of
+        // generate_gamma_matrices,
+        //   gamma_mu = [[0, A], [A^dagger, 0]]
+        // and row a of the 2x2 block A has the single non-zero element
+        // Re_a + i Im_a in column Col_a. The upper components of
+        // (1 - Sign * gamma_mu) psi form the half-spinor
+        //   h = psi_upper - Sign * A psi_lower
+        // and the lower components are -Sign * A^dagger h.
+        template <int Sign, typename Vector>
+        static void project(const Vector* spinor, Vector& half_spinor0,
+                            Vector& half_spinor1)
+        {
+          add_times_unit<-Sign * Re0, -Sign * Im0>(
+              spinor[0], spinor[2 + Col0], half_spinor0);
+          add_times_unit<-Sign * Re1, -Sign * Im1>(
+              spinor[1], spinor[2 + Col1], half_spinor1);
+        }
+
+        template <int Sign, typename Vector>
+        static void reconstruct(const Vector& half_spinor0,
+                                const Vector& half_spinor1, Vector* spinor)
+        {
+          spinor[0] += half_spinor0;
+          spinor[1] += half_spinor1;
+          accumulate_times_unit<-Sign * Re0, Sign * Im0>(
+              half_spinor0, spinor[2 + Col0]);
+          accumulate_times_unit<-Sign * Re1, Sign * Im1>(
+              half_spinor1, spinor[2 + Col1]);
+        }
+      };
+
+      // A_0 = 1 and A_k = -i sigma_k for k = 1, 2, 3
+      template <unsigned int Mu>
+      struct WilsonSpinProjection;
+      template <>
+      struct WilsonSpinProjection<0> : WilsonProjection<0, 1, 0, 1, 1, 0> {};
+      template <>
+      struct WilsonSpinProjection<1> : WilsonProjection<1, 0, -1, 0, 0, -1> {};
+      template <>
+      struct WilsonSpinProjection<2> : WilsonProjection<1, -1, 0, 0, 1, 0> {};
+      template <>
+      struct WilsonSpinProjection<3> : WilsonProjection<0, 0, -1, 1, 0, 1> {};
+
+      struct NoEpilogue
+      {
+        template <typename Fermion>
+        void operator()(const unsigned int, const Int, const Int,
+                        Fermion&) const
+        {}
+      };
+    }
+
+
+    template <typename Real, int Nc>
+    struct ScaleAddEpilogue
+    {
+      // Epilogue for HoppingMatrix::apply_checkerboard that replaces the
+      // hopping term h on each output site x with
+      //   spin_scales[alpha] * (hop_scale * h(x) + diag_scale * diags[k](x))
+      // where k is the index of the fermion within the batch (zero for a
+      // single fermion). diags must be defined on the same layout as the
+      // output, and either diags or spin_scales may be null, in which case
+      // the corresponding term or factor is omitted.
+      void operator()(const unsigned int k, const Int offset,
+                      const Int num_spins,
+                      LatticeColourVector<Real, Nc>& fermion_out) const
+      {
+        for (Int alpha = 0; alpha < num_spins; ++alpha) {
+          const Real spin_scale =
+              spin_scales != nullptr ? spin_scales[alpha] : Real(1);
+          auto& elem = fermion_out[offset + alpha];
+          if (diags != nullptr) {
+            elem = (spin_scale * hop_scale) * elem
+                   + (spin_scale * diag_scale) * diags[k][offset + alpha];
+          }
+          else {
+            elem *= spin_scale * hop_scale;
+          }
+        }
+      }
+
+      Real hop_scale;
+      const LatticeColourVector<Real, Nc>* diags;
+      Real diag_scale;
+      const Real* spin_scales;
+    };
+
+
     template <typename Real, int Nc, unsigned int Nhops>
     class HoppingMatrix
     {
     public:
       HoppingMatrix(const LatticeColourMatrix <Real, Nc>& gauge_field,
                     const std::vector<std::complex<Real>>& phases,
-                    std::vector<SpinMatrix<Real>> spin_structures);
+                    std::vector<SpinMatrix<Real>> spin_structures,
+                    const LinkCompression compression = LinkCompression::None);
+      // Create a copy of a hopping matrix with a different precision
+      template <typename OtherReal>
+      explicit HoppingMatrix(const HoppingMatrix<OtherReal, Nc, Nhops>& other);
 
       unsigned int num_spins() const { return num_spins_; }
+      LinkCompression compression() const { return compression_; }
+      SpinKernel spin_kernel() const { return spin_kernel_; }
 
       LatticeColourVector<Real, Nc> apply_full(
           const LatticeColourVector<Real, Nc>& in) const;
@@ -48,14 +434,202 @@ namespace pyQCD
       LatticeColourVector<Real, Nc> apply_odd_even(
           const LatticeColourVector<Real, Nc>& in) const;
 
+      // In-place variants of the above. The output must not alias the input.
+      // The even-odd variants only write to the sites of the output parity.
+      void apply_full(const LatticeColourVector<Real, Nc>& in,
+                      LatticeColourVector<Real, Nc>& out) const;
+
+      void apply_even_odd(const LatticeColourVector<Real, Nc>& in,
+                          LatticeColourVector<Real, Nc>& out) const;
+
+      void apply_odd_even(const LatticeColourVector<Real, Nc>& in,
+                          LatticeColourVector<Real, Nc>& out) const;
+
+      // Batched variants of the above, which apply the hopping matrix to each
+      // fermion in the supplied batch. All fermions must be defined on the
+      // lattice of the hopping matrix, and the in-place variants require out
+      // to contain as many fermions as in, none of which alias an input.
+      std::vector<LatticeColourVector<Real, Nc>> apply_full(
+          const std::vector<LatticeColourVector<Real, Nc>>& in) const;
+
+      void apply_full(const std::vector<LatticeColourVector<Real, Nc>>& in,
+                      std::vector<LatticeColourVector<Real, Nc>>& out) const;
+
+      void apply_even_odd(
+          const std::vector<LatticeColourVector<Real, Nc>>& in,
+          std::vector<LatticeColourVector<Real, Nc>>& out) const;
+
+      void apply_odd_even(
+          const std::vector<LatticeColourVector<Real, Nc>>& in,
+          std::vector<LatticeColourVector<Real, Nc>>& out) const;
+
+      // Variants of the above for half-volume fermions defined on a
+      // CheckerboardLayout. The hopping matrix is applied on the sites of the
+      // parity of out, so in must have the opposite parity (or the same
+      // parity if Nhops is even). Requires all lattice extents to be even.
+      void apply_checkerboard(const LatticeColourVector<Real, Nc>& in,
+                              LatticeColourVector<Real, Nc>& out) const;
+
+      void apply_checkerboard(
+          const std::vector<LatticeColourVector<Real, Nc>>& in,
+          std::vector<LatticeColourVector<Real, Nc>>& out) const;
+
+      // As above, but calling epilogue(k, offset, num_spins, out[k]) on each
+      // output site after its hopping term has been computed, where the site
+      // occupies elements [offset, offset + num_spins) of out[k]. See
+      // ScaleAddEpilogue.
+      template <typename Epilogue>
+      void apply_checkerboard(const LatticeColourVector<Real, Nc>& in,
+                              LatticeColourVector<Real, Nc>& out,
+                              const Epilogue& epilogue) const;
+
+      template <typename Epilogue>
+      void apply_checkerboard(
+          const std::vector<LatticeColourVector<Real, Nc>>& in,
+          std::vector<LatticeColourVector<Real, Nc>>& out,
+          const Epilogue& epilogue) const;
+
     private:
-      unsigned int num_spins_;
+      template <typename OtherReal, int OtherNc, unsigned int OtherNhops>
+      friend class HoppingMatrix;
+
+      using SpinEntry = typename SpinProjectionTable<Real>::Entry;
+
+      void compute_projections();
+
+      template <LinkCompression Compression>
+      void compress_links();
+
+      // Returns the 2 * num_dims links used to hop onto the site with the
+      // specified array index. Compressed links are first reconstructed into
+      // buffer, which must have space for 2 * num_dims links.
+      const ColourMatrix<Real, Nc>* load_links(
+          const Int arr_index, ColourMatrix<Real, Nc>*,
+          detail::CompressionTag<LinkCompression::None>) const
+      { return &scattered_gauge_field_[2 * num_dims_ * arr_index]; }
+      template <LinkCompression Compression>
+      const ColourMatrix<Real, Nc>* load_links(
+          const Int arr_index, ColourMatrix<Real, Nc>* buffer,
+          detail::CompressionTag<Compression>) const;
+
+      // Apply the hopping matrix on the sites with the specified array
+      // indices, or on all sites if arr_indices is null. Fermions is either a
+      // single fermion or a batch of fermions. If cb_neighbours is not null
+      // the fermions are checkerboarded, so the result for site
+      // (*arr_indices)[i] is written to checkerboard index i, and
+      // cb_neighbours holds the checkerboard indices of its neighbours.
+      template <typename Fermions, typename Epilogue = detail::NoEpilogue>
+      void apply_sites(const Fermions& fermion_in,
+                       const std::vector<Int>* arr_indices,
+                       const std::vector<Int>* cb_neighbours,
+                       Fermions& fermion_out,
+                       const Epilogue& epilogue = Epilogue()) const;
+      template <typename Fermions, typename Epilogue, SpinKernel Kernel>
+      void apply_sites(const Fermions& fermion_in,
+                       const std::vector<Int>* arr_indices,
+                       const std::vector<Int>* cb_neighbours,
+                       Fermions& fermion_out, const Epilogue& epilogue,
+                       detail::SpinKernelTag<Kernel>) const;
+      template <LinkCompression Compression, SpinKernel Kernel,
+                typename Epilogue>
+      void apply_sites(const LatticeColourVector<Real, Nc>& fermion_in,
+                       const std::vector<Int>* arr_indices,
+                       const std::vector<Int>* cb_neighbours,
+                       LatticeColourVector<Real, Nc>& fermion_out,
+                       const Epilogue& epilogue) const;
+      template <LinkCompression Compression, SpinKernel Kernel,
+                typename Epilogue>
+      void apply_sites(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          const std::vector<Int>* arr_indices,
+          const std::vector<Int>* cb_neighbours,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+          const Epilogue& epilogue) const;
+
+      void check_fermions(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          const LatticeColourVector<Real, Nc>& fermion_out) const;
+      void check_batch(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const;
+      // Returns the parity of out, having checked that in and out are
+      // compatible checkerboarded fermions.
+      Parity check_checkerboard(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          const LatticeColourVector<Real, Nc>& fermion_out) const;
+
+      Int num_sites() const
+      { return neighbour_array_indices_->size() / (2 * num_dims_); }
+
+      // Number of sites in each tile when applying the hopping matrix to a
+      // batch of fermions. The links for a tile of 64 sites in four
+      // dimensions occupy around 72 KB in double precision, so remain
+      // resident in L2 cache whilst the tile is applied to each fermion.
+      // Compressed links are reconstructed into a per-thread buffer of this
+      // size once per tile, rather than once per fermion.
+      static constexpr Int batch_tile_size = 64;
+
+      // Apply the hopping matrix to the index-th site processed by
+      // apply_sites, which has array index arr_index and hops using links.
+      template <LinkCompression Compression, SpinKernel Kernel,
+                typename Epilogue>
+      void apply_site(const LatticeColourVector<Real, Nc>& fermion_in,
+                      const Int index, const Int arr_index,
+                      const ColourMatrix<Real, Nc>* links,
+                      const std::vector<Int>* cb_neighbours,
+                      const unsigned int batch_index, const Epilogue& epilogue,
+                      LatticeColourVector<Real, Nc>& fermion_out) const;
+      void apply_site(const LatticeColourVector<Real, Nc>& fermion_in,
+                      const ColourMatrix<Real, Nc>* links,
+                      const std::uint64_t boundary_mask,
+                      const Int* neighbour_indices, const Int out_index,
+                      LatticeColourVector<Real, Nc>& fermion_out,
+                      detail::SpinKernelTag<SpinKernel::Table>) const;
+      void apply_site(const LatticeColourVector<Real, Nc>& fermion_in,
+                      const ColourMatrix<Real, Nc>* links,
+                      const std::uint64_t boundary_mask,
+                      const Int* neighbour_indices, const Int out_index,
+                      LatticeColourVector<Real, Nc>& fermion_out,
+                      detail::SpinKernelTag<SpinKernel::Wilson>) const;
+      // Accumulate the contribution of the hop in direction Mu, forward if
+      // Sign is 1 and backward if Sign is -1, to the Wilson kernel's result
+      template <unsigned int Mu, int Sign>
+      void apply_wilson_hop(const LatticeColourVector<Real, Nc>& fermion_in,
+                            const ColourMatrix<Real, Nc>* links,
+                            const std::uint64_t boundary_mask,
+                            const Int* neighbour_indices,
+                            ColourVector<Real, Nc>* result) const;
+
+      unsigned int num_dims_, num_spins_, num_half_spins_;
+      LinkCompression compression_;
+      SpinKernel spin_kernel_;
+      // Links used to hop onto each site, arranged as [site][2 * mu + hop],
+      // where hop = 0 denotes the hop from x + mu and hop = 1 denotes the hop
+      // from x - mu. Boundary phases and adjoints are folded in. This is
+      // emptied once the links have been compressed.
       LatticeColourMatrix<Real, Nc> scattered_gauge_field_;
+      // Compressed form of scattered_gauge_field_ without the boundary phases,
+      // along with a per-site bit mask denoting which hops pick up a phase
+      // and the phase for each hop.
+      aligned_vector<Real> compressed_links_;
+      std::vector<std::uint64_t> boundary_masks_;
+      std::vector<std::complex<Real>> hop_phases_;
       std::vector<SpinMatrix<Real>> spin_structures_;
-      std::vector<std::vector<Int>> neighbour_array_indices_;
+      // See SpinProjectionTable
+      std::vector<std::vector<SpinEntry>> projector_entries_;
+      std::vector<std::vector<SpinEntry>> reconstructor_entries_;
+      // Array indices of the sites neighbouring each site, arranged as
+      // [array_index][2 * mu + hop], with hop as for scattered_gauge_field_.
+      // This is the shift table owned by the layout of the gauge field, which
+      // must therefore outlive the hopping matrix.
+      const std::vector<Int>* neighbour_array_indices_;
       std::vector<Int> even_array_indices_, odd_array_indices_;
-      std::vector<std::vector<Int>> neighbour_array_indices_even_;
-      std::vector<std::vector<Int>> neighbour_array_indices_odd_;
+      // Tables for checkerboarded fermions, indexed by parity. The first
+      // holds the (full) array index of each checkerboard site, the second
+      // the checkerboard indices of its neighbours, arranged as for
+      // neighbour_array_indices_. These are empty if any extent is odd.
+      std::array<std::vector<Int>, 2> cb_array_indices_;
+      std::array<std::vector<Int>, 2> cb_neighbour_indices_;
     };
 
 
@@ -63,29 +637,44 @@ namespace pyQCD
     HoppingMatrix<Real, Nc, Nhops>::HoppingMatrix(
         const LatticeColourMatrix <Real, Nc>& gauge_field,
         const std::vector<std::complex<Real>>& phases,
-        std::vector<SpinMatrix<Real>> spin_structures)
-      : num_spins_(
+        std::vector<SpinMatrix<Real>> spin_structures,
+        const LinkCompression compression)
+      : num_dims_(gauge_field.num_dims()),
+        num_spins_(
           static_cast<unsigned int>(std::pow(2, gauge_field.num_dims() / 2))),
+        compression_(compression),
         scattered_gauge_field_(gauge_field.layout(), 2 * gauge_field.num_dims()),
         spin_structures_(std::move(spin_structures))
     {
+      spin_kernel_ =
+          detail::is_wilson_spin_structures(spin_structures_, num_dims_) ?
+          SpinKernel::Wilson : SpinKernel::Table;
+
+      if (compression_ != LinkCompression::None) {
+        if (Nc != 3) {
+          throw std::invalid_argument(
+              "Link compression is only supported for SU(3) gauge fields");
+        }
+        if (2 * num_dims_ > 64) {
+          throw std::invalid_argument(
+              "Link compression is only supported for up to 32 dimensions");
+        }
+      }
+
+      compute_projections();
+
       auto& layout = gauge_field.layout();
       auto volume = gauge_field.volume();
-      neighbour_array_indices_ = std::vector<std::vector<Int>>(
-          volume, std::vector<Int>(layout.num_dims() * 2));
+      neighbour_array_indices_ = &layout.shift_table(Nhops);
       even_array_indices_.reserve(volume / 2);
       odd_array_indices_.reserve(volume / 2);
-      neighbour_array_indices_even_.resize(volume / 2);
-      neighbour_array_indices_odd_.resize(volume / 2);
 
-      std::vector<Int> even_odd_gather_mapping(volume, 0);
+      Site site_coords(num_dims_);
 
-      // Scatter the supplied gauge field U_\mu (x) so that when we wish to
-      // multiply it with the supplied lattice fermion, there won't be frequent
-      // cache misses.
+      // Gather the links required to hop onto each site x, so that the
+      // hopping kernel can read them contiguously alongside the output site.
       for (unsigned site_index = 0; site_index < volume; ++site_index) {
         auto arr_index = layout.get_array_index(site_index);
-        even_odd_gather_mapping[arr_index] = site_index / 2;
 
         if (layout.is_even_site(site_index)) {
           even_array_indices_.push_back(arr_index);
@@ -94,133 +683,364 @@ namespace pyQCD
           odd_array_indices_.push_back(arr_index);
         }
 
-        for (unsigned d = 0; d < layout.num_dims(); ++d) {
-
-          auto site_coords = layout.compute_site_coords(site_index);
+        layout.compute_site_coords(site_index, site_coords);
 
-          auto phase_fwd = (site_coords[d] + Nhops >= layout.shape()[d]) ?
-                           phases[d] : std::complex<Real>(1.0);
-          auto phase_bck = (site_coords[d] < Nhops) ?
-                           phases[d] : std::complex<Real>(1.0);
+        for (unsigned d = 0; d < num_dims_; ++d) {
+          const auto extent = layout.shape()[d];
 
-          scattered_gauge_field_(site_index, 2 * d) =
-              ColourMatrix<double, 3>::Identity() * phase_bck;
-          scattered_gauge_field_(site_index, 2 * d + 1) =
-              ColourMatrix<double, 3>::Identity() * phase_fwd;
+          const auto phase_fwd = (site_coords[d] + Nhops >= extent) ?
+                                 phases[d] : std::complex<Real>(1.0);
+          const auto phase_bck = (site_coords[d] < Nhops) ?
+                                 phases[d] : std::complex<Real>(1.0);
 
-          // Move along the lines connecting the current
-          for (unsigned h = 0; h < Nhops; ++h) {
-            site_coords[d] += h - Nhops;
-            layout.sanitize_site_coords(site_coords);
-            scattered_gauge_field_(site_index, 2 * d) *=
-                gauge_field(site_coords, d);
+          // Product of links along the line from x to x + Nhops * mu...
+          ColourMatrix<Real, Nc> link_fwd =
+              ColourMatrix<Real, Nc>::Identity() * phase_fwd;
+          // ...and from x - Nhops * mu to x.
+          ColourMatrix<Real, Nc> link_bck =
+              ColourMatrix<Real, Nc>::Identity() * phase_bck;
 
-            site_coords[d] += Nhops;
-            layout.sanitize_site_coords(site_coords);
-            scattered_gauge_field_(site_index, 2 * d + 1) *=
-                gauge_field(site_coords, d);
+          const int num_hops = Nhops;
 
-            site_coords[d] -= h;
+          for (int h = 0; h < num_hops; ++h) {
+            link_fwd *= gauge_field(
+                layout.shift_site_index(site_index, d, h), d);
+            link_bck *= gauge_field(
+                layout.shift_site_index(site_index, d, h - num_hops), d);
           }
 
-          // Compute coordinates/indices of the neighbours of the current site
-          site_coords[d] -= Nhops;
-          layout.sanitize_site_coords(site_coords);
-          auto site_index_minus =
-              layout.get_site_index(layout.get_array_index(site_coords));
-          site_coords[d] += 2 * Nhops;
-          layout.sanitize_site_coords(site_coords);
-          auto site_index_plus =
-              layout.get_site_index(layout.get_array_index(site_coords));
-          site_coords[d] -= Nhops;
-
-          auto arr_index_minus = layout.get_array_index(site_index_minus);
-          auto arr_index_plus = layout.get_array_index(site_index_plus);
-          neighbour_array_indices_[arr_index][2 * d] = arr_index_minus;
-          neighbour_array_indices_[arr_index][2 * d + 1] = arr_index_plus;
+          scattered_gauge_field_(site_index, 2 * d) = link_fwd;
+          scattered_gauge_field_(site_index, 2 * d + 1) = link_bck.adjoint();
         }
       }
 
       std::sort(even_array_indices_.begin(), even_array_indices_.end());
       std::sort(odd_array_indices_.begin(), odd_array_indices_.end());
 
-      // Run through even and odd site indices and populate
-      // neighbour_array_indices_even_/neighbour_array_indices_odd_. These
-      // can be populated using the information contained in
-      // neighbour_array_indices_, even_array_indices and odd_array_indices_.
-      for (unsigned int i = 0; i < volume / 2; ++i) {
-        const auto even_arr_index = even_array_indices_[i];
-        const auto odd_arr_index = odd_array_indices_[i];
-
-        neighbour_array_indices_even_[i].resize(2 * layout.num_dims());
-        neighbour_array_indices_odd_[i].resize(2 * layout.num_dims());
-
-        for (unsigned int d = 0; d < 2 * layout.num_dims(); ++d) {
-          const auto even_neighbour_arr_index =
-              neighbour_array_indices_[even_arr_index][d];
-          const auto odd_neighbour_arr_index =
-              neighbour_array_indices_[odd_arr_index][d];
-
-          neighbour_array_indices_even_[i][d] =
-              even_odd_gather_mapping[even_neighbour_arr_index];
-          neighbour_array_indices_odd_[i][d] =
-              even_odd_gather_mapping[odd_neighbour_arr_index];
+      // The checkerboard index of a site is its rank amongst the sites of the
+      // same parity in lexicographic order, as for CheckerboardLayout.
+      // Checkerboarding is only consistent if all extents are even.
+      const auto& shape = layout.shape();
+      const bool checkerboardable = std::all_of(
+          shape.begin(), shape.end(),
+          [] (const unsigned int extent) { return extent % 2 == 0; });
+
+      if (checkerboardable) {
+        std::vector<Int> cb_indices(volume);
+        std::array<Int, 2> counts{{0, 0}};
+        for (unsigned site_index = 0; site_index < volume; ++site_index) {
+          const auto parity = layout.is_even_site(site_index) ? 0 : 1;
+          cb_indices[layout.get_array_index(site_index)] = counts[parity]++;
+          cb_array_indices_[parity].push_back(
+              layout.get_array_index(site_index));
         }
+
+        for (unsigned int parity = 0; parity < 2; ++parity) {
+          const auto& arr_indices = cb_array_indices_[parity];
+          auto& neighbours = cb_neighbour_indices_[parity];
+          neighbours.resize(arr_indices.size() * 2 * num_dims_);
+
+          for (Int i = 0; i < arr_indices.size(); ++i) {
+            for (unsigned hop = 0; hop < 2 * num_dims_; ++hop) {
+              const Int link_index = 2 * num_dims_ * arr_indices[i] + hop;
+              neighbours[2 * num_dims_ * i + hop] =
+                  cb_indices[(*neighbour_array_indices_)[link_index]];
+            }
+          }
+        }
+      }
+
+      if (compression_ == LinkCompression::None) {
+        return;
+      }
+
+      // The phases were folded into the scattered links above, so here we
+      // record which hops crossed a boundary with a non-trivial phase so that
+      // the phases can be divided out again before compression.
+      hop_phases_.resize(2 * num_dims_);
+      boundary_masks_.assign(volume, 0);
+
+      for (unsigned d = 0; d < num_dims_; ++d) {
+        hop_phases_[2 * d] = phases[d];
+        hop_phases_[2 * d + 1] = std::conj(phases[d]);
+      }
+
+      for (unsigned site_index = 0; site_index < volume; ++site_index) {
+        const auto arr_index = layout.get_array_index(site_index);
+        layout.compute_site_coords(site_index, site_coords);
+
+        for (unsigned d = 0; d < num_dims_; ++d) {
+          if (phases[d] == std::complex<Real>(1.0)) {
+            continue;
+          }
+          const auto extent = layout.shape()[d];
+          const Int link_index = 2 * num_dims_ * arr_index + 2 * d;
+
+          if (site_coords[d] + Nhops >= extent) {
+            boundary_masks_[arr_index] |= std::uint64_t(1) << (2 * d);
+            scattered_gauge_field_[link_index] /= hop_phases_[2 * d];
+          }
+          if (site_coords[d] < Nhops) {
+            boundary_masks_[arr_index] |= std::uint64_t(1) << (2 * d + 1);
+            scattered_gauge_field_[link_index + 1] /= hop_phases_[2 * d + 1];
+          }
+        }
+      }
+
+      if (compression_ == LinkCompression::EightReal and
+          not detail::can_compress_links_8(scattered_gauge_field_)) {
+        compression_ = LinkCompression::TwelveReal;
+      }
+
+      if (compression_ == LinkCompression::TwelveReal) {
+        compress_links<LinkCompression::TwelveReal>();
+      }
+      else {
+        compress_links<LinkCompression::EightReal>();
       }
     }
 
 
     template <typename Real, int Nc, unsigned int Nhops>
-    LatticeColourVector<Real, Nc> HoppingMatrix<Real, Nc, Nhops>::apply_full(
-        const LatticeColourVector<Real, Nc>& fermion_in) const
+    template <typename OtherReal>
+    HoppingMatrix<Real, Nc, Nhops>::HoppingMatrix(
+        const HoppingMatrix<OtherReal, Nc, Nhops>& other)
+      : num_dims_(other.num_dims_), num_spins_(other.num_spins_),
+        compression_(other.compression_), spin_kernel_(other.spin_kernel_),
+        scattered_gauge_field_(
+            convert_precision<Real>(other.scattered_gauge_field_)),
+        compressed_links_(other.compressed_links_.begin(),
+                          other.compressed_links_.end()),
+        boundary_masks_(other.boundary_masks_),
+        hop_phases_(other.hop_phases_.begin(), other.hop_phases_.end()),
+        neighbour_array_indices_(other.neighbour_array_indices_),
+        even_array_indices_(other.even_array_indices_),
+        odd_array_indices_(other.odd_array_indices_),
+        cb_array_indices_(other.cb_array_indices_),
+        cb_neighbour_indices_(other.cb_neighbour_indices_)
     {
-      auto& layout = fermion_in.layout();
-      auto ndims = layout.num_dims();
-      auto volume = layout.volume();
-      LatticeColourVector<Real, Nc> pre_gather_results(
-          layout, ColourVector<Real, Nc>::Zero(), ndims * num_spins_ * 2);
-
-#pragma omp parallel for
-      for (unsigned arr_index = 0; arr_index < volume; ++arr_index) {
-        for (unsigned mu = 0; mu < ndims; ++mu) {
-          Int local_index = 2 * (ndims * arr_index + mu);
-          for (unsigned alpha = 0; alpha < num_spins_; ++alpha) {
-            for (unsigned beta = 0; beta < num_spins_; ++beta) {
-              pre_gather_results[num_spins_ * local_index + 2 * alpha] +=
-                  spin_structures_[2 * mu].coeff(alpha, beta) *
-                  scattered_gauge_field_[local_index] *
-                  fermion_in[num_spins_ * arr_index + beta];
-              pre_gather_results[num_spins_ * local_index + 2 * alpha + 1] +=
-                  spin_structures_[2 * mu + 1].coeff(alpha, beta) *
-                  scattered_gauge_field_[local_index + 1].adjoint() *
-                  fermion_in[num_spins_ * arr_index + beta];
-            }
-          }
-        }
+      spin_structures_.reserve(other.spin_structures_.size());
+      for (const auto& spin_structure : other.spin_structures_) {
+        spin_structures_.push_back(
+            spin_structure.template cast<std::complex<Real>>());
       }
 
-      LatticeColourVector<Real, Nc> fermion_out(
-          layout, ColourVector<Real, Nc>::Zero(), num_spins_);
-
-#pragma omp parallel for
-      for (unsigned arr_index = 0; arr_index < volume; ++arr_index) {
-        for (unsigned mu = 0; mu < ndims; ++mu) {
-          const auto neighbour_index_plus =
-              num_spins_ *
-                  (ndims * neighbour_array_indices_[arr_index][2 * mu] + mu);
-          const auto neighbour_index_minus =
-              num_spins_ *
-                  (ndims * neighbour_array_indices_[arr_index][2 * mu + 1] + mu);
-          for (unsigned alpha = 0; alpha < num_spins_; ++alpha) {
-            Int gather_index_plus = 2 * (neighbour_index_plus + alpha);
-            Int gather_index_minus = 2 * (neighbour_index_minus + alpha);
-            fermion_out[num_spins_ * arr_index + alpha] +=
-                pre_gather_results[gather_index_minus];
-            fermion_out[num_spins_ * arr_index + alpha] +=
-                pre_gather_results[gather_index_plus + 1];
+      compute_projections();
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    template <LinkCompression Compression>
+    void HoppingMatrix<Real, Nc, Nhops>::compress_links()
+    {
+      using Codec = detail::LinkCodec<Real, Nc, Compression>;
+
+      const auto num_links = scattered_gauge_field_.size();
+      compressed_links_.resize(Codec::size * num_links);
+
+      for (unsigned long i = 0; i < num_links; ++i) {
+        Codec::compress(scattered_gauge_field_[i],
+                        &compressed_links_[Codec::size * i]);
+      }
+
+      scattered_gauge_field_ = LatticeColourMatrix<Real, Nc>(
+          scattered_gauge_field_.layout(), 0);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    template <LinkCompression Compression>
+    const ColourMatrix<Real, Nc>* HoppingMatrix<Real, Nc, Nhops>::load_links(
+        const Int arr_index, ColourMatrix<Real, Nc>* buffer,
+        detail::CompressionTag<Compression>) const
+    {
+      using Codec = detail::LinkCodec<Real, Nc, Compression>;
+      const Int num_hops = 2 * num_dims_;
+      const Real* data = &compressed_links_[Codec::size * num_hops * arr_index];
+
+      for (Int hop = 0; hop < num_hops; ++hop) {
+        Codec::reconstruct(data + Codec::size * hop, buffer[hop]);
+      }
+      return buffer;
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::compute_projections()
+    {
+      SpinProjectionTable<Real> table(spin_structures_, num_spins_);
+      num_half_spins_ = table.num_half_spins;
+      projector_entries_ = std::move(table.projector_entries);
+      reconstructor_entries_ = std::move(table.reconstructor_entries);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    template <LinkCompression Compression, SpinKernel Kernel,
+              typename Epilogue>
+    inline void HoppingMatrix<Real, Nc, Nhops>::apply_site(
+        const LatticeColourVector<Real, Nc>& fermion_in, const Int index,
+        const Int arr_index, const ColourMatrix<Real, Nc>* links,
+        const std::vector<Int>* cb_neighbours, const unsigned int batch_index,
+        const Epilogue& epilogue,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      // Look up the neighbours of the index-th site processed by apply_sites.
+      // Boundary phases are only folded into uncompressed links.
+      const bool compressed = Compression != LinkCompression::None;
+      const std::uint64_t boundary_mask =
+          compressed ? boundary_masks_[arr_index] : 0;
+
+      if (cb_neighbours != nullptr) {
+        apply_site(fermion_in, links, boundary_mask,
+                   &(*cb_neighbours)[2 * num_dims_ * index], index,
+                   fermion_out, detail::SpinKernelTag<Kernel>());
+        epilogue(batch_index, num_spins_ * index, num_spins_, fermion_out);
+        return;
+      }
+
+      apply_site(fermion_in, links, boundary_mask,
+                 &(*neighbour_array_indices_)[2 * num_dims_ * arr_index],
+                 arr_index, fermion_out, detail::SpinKernelTag<Kernel>());
+      epilogue(batch_index, num_spins_ * arr_index, num_spins_, fermion_out);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    inline void HoppingMatrix<Real, Nc, Nhops>::apply_site(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        const ColourMatrix<Real, Nc>* links, const std::uint64_t boundary_mask,
+        const Int* neighbour_indices, const Int out_index,
+        LatticeColourVector<Real, Nc>& fermion_out,
+        detail::SpinKernelTag<SpinKernel::Table>) const
+    {
+      // Compute the hopping term on a single site by pulling in the spinors
+      // on each of the neighbouring sites. Each neighbouring spinor is
+      // projected onto a half-spinor, one spin component at a time, which is
+      // then multiplied by the relevant link and reconstructed directly into
+      // the output. The fermions are indexed using neighbour_indices and
+      // out_index, and hops with bits set in boundary_mask pick up a phase.
+      const Int out_offset = num_spins_ * out_index;
+
+      for (unsigned int alpha = 0; alpha < num_spins_; ++alpha) {
+        fermion_out[out_offset + alpha].setZero();
+      }
+
+      ColourVector<Real, Nc> half_spinor;
+      ColourVector<Real, Nc> transported;
+
+      for (unsigned int hop = 0; hop < 2 * num_dims_; ++hop) {
+        const Int in_offset = num_spins_ * neighbour_indices[hop];
+        const auto& link = links[hop];
+        const bool apply_phase = (boundary_mask >> hop) & 1;
+
+        auto proj_entry = projector_entries_[hop].begin();
+        const auto proj_end = projector_entries_[hop].end();
+        auto recon_entry = reconstructor_entries_[hop].begin();
+        const auto recon_end = reconstructor_entries_[hop].end();
+
+        for (unsigned int a = 0; a < num_half_spins_; ++a) {
+          half_spinor.setZero();
+          for (; proj_entry != proj_end and proj_entry->row == a;
+               ++proj_entry) {
+            half_spinor +=
+                proj_entry->coeff * fermion_in[in_offset + proj_entry->col];
+          }
+
+          if (apply_phase) {
+            half_spinor *= hop_phases_[hop];
+          }
+
+          transported.noalias() = link * half_spinor;
+
+          for (; recon_entry != recon_end and recon_entry->col == a;
+               ++recon_entry) {
+            fermion_out[out_offset + recon_entry->row] +=
+                recon_entry->coeff * transported;
           }
         }
       }
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    inline void HoppingMatrix<Real, Nc, Nhops>::apply_site(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        const ColourMatrix<Real, Nc>* links, const std::uint64_t boundary_mask,
+        const Int* neighbour_indices, const Int out_index,
+        LatticeColourVector<Real, Nc>& fermion_out,
+        detail::SpinKernelTag<SpinKernel::Wilson>) const
+    {
+      // As above, but for the Wilson spin structures in four dimensions. The
+      // eight hops are unrolled, and the spin projections are applied as
+      // additions and subtractions of spin components. The result is
+      // accumulated locally and written to the output once.
+      ColourVector<Real, Nc> result[4];
+      for (auto& spinor : result) {
+        spinor.setZero();
+      }
+
+      apply_wilson_hop<0, 1>(fermion_in, links, boundary_mask,
+                             neighbour_indices, result);
+      apply_wilson_hop<0, -1>(fermion_in, links, boundary_mask,
+                              neighbour_indices, result);
+      apply_wilson_hop<1, 1>(fermion_in, links, boundary_mask,
+                             neighbour_indices, result);
+      apply_wilson_hop<1, -1>(fermion_in, links, boundary_mask,
+                              neighbour_indices, result);
+      apply_wilson_hop<2, 1>(fermion_in, links, boundary_mask,
+                             neighbour_indices, result);
+      apply_wilson_hop<2, -1>(fermion_in, links, boundary_mask,
+                              neighbour_indices, result);
+      apply_wilson_hop<3, 1>(fermion_in, links, boundary_mask,
+                             neighbour_indices, result);
+      apply_wilson_hop<3, -1>(fermion_in, links, boundary_mask,
+                              neighbour_indices, result);
+
+      const Int out_offset = 4 * out_index;
+      for (unsigned int alpha = 0; alpha < 4; ++alpha) {
+        fermion_out[out_offset + alpha] = Real(-0.5) * result[alpha];
+      }
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    template <unsigned int Mu, int Sign>
+    inline void HoppingMatrix<Real, Nc, Nhops>::apply_wilson_hop(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        const ColourMatrix<Real, Nc>* links, const std::uint64_t boundary_mask,
+        const Int* neighbour_indices, ColourVector<Real, Nc>* result) const
+    {
+      // The forward hop from x + mu uses the spin structure
+      // -(1 - gamma_mu) / 2 and the backward hop from x - mu uses
+      // -(1 + gamma_mu) / 2. The factor of -1 / 2 is applied by the caller.
+      using Projection = detail::WilsonSpinProjection<Mu>;
+      const unsigned int hop = 2 * Mu + (Sign > 0 ? 0 : 1);
+
+      ColourVector<Real, Nc> half_spinor0, half_spinor1;
+      Projection::template project<Sign>(
+          &fermion_in[4 * neighbour_indices[hop]], half_spinor0, half_spinor1);
+
+      if ((boundary_mask >> hop) & 1) {
+        half_spinor0 *= hop_phases_[hop];
+        half_spinor1 *= hop_phases_[hop];
+      }
+
+      const ColourVector<Real, Nc> transported0 = links[hop] * half_spinor0;
+      const ColourVector<Real, Nc> transported1 = links[hop] * half_spinor1;
+
+      Projection::template reconstruct<Sign>(transported0, transported1,
+                                             result);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    LatticeColourVector<Real, Nc> HoppingMatrix<Real, Nc, Nhops>::apply_full(
+        const LatticeColourVector<Real, Nc>& fermion_in) const
+    {
+      LatticeColourVector<Real, Nc> fermion_out(
+          fermion_in.layout(), num_spins_);
+      apply_full(fermion_in, fermion_out);
 
       return fermion_out;
     }
@@ -230,116 +1050,367 @@ namespace pyQCD
     LatticeColourVector<Real, Nc> HoppingMatrix<Real, Nc, Nhops>::apply_even_odd(
         const LatticeColourVector<Real, Nc>& fermion_in) const
     {
-      auto& layout = fermion_in.layout();
-      auto ndims = layout.num_dims();
-      auto volume = layout.volume();
-      aligned_vector<ColourVector<Real, Nc>> pre_gather_results(
-          volume * ndims * num_spins_, ColourVector<Real, Nc>::Zero());
-
-#pragma omp parallel for
-      for (unsigned int i = 0; i < odd_array_indices_.size(); ++i) {
-        auto arr_index = odd_array_indices_[i];
-        for (unsigned mu = 0; mu < ndims; ++mu) {
-          Int gather_index = 2 * (ndims * i + mu);
-          Int local_index = 2 * (ndims * arr_index + mu);
-          for (unsigned alpha = 0; alpha < num_spins_; ++alpha) {
-            for (unsigned beta = 0; beta < num_spins_; ++beta) {
-              pre_gather_results[num_spins_ * gather_index + 2 * alpha] +=
-                  spin_structures_[2 * mu].coeff(alpha, beta) *
-                  scattered_gauge_field_[local_index] *
-                  fermion_in[num_spins_ * arr_index + beta];
-              pre_gather_results[num_spins_ * gather_index + 2 * alpha + 1] +=
-                  spin_structures_[2 * mu + 1].coeff(alpha, beta) *
-                  scattered_gauge_field_[local_index + 1].adjoint() *
-                  fermion_in[num_spins_ * arr_index + beta];
-            }
-          }
+      LatticeColourVector<Real, Nc> fermion_out(
+          fermion_in.layout(), ColourVector<Real, Nc>::Zero(), num_spins_);
+      apply_even_odd(fermion_in, fermion_out);
+
+      return fermion_out;
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    LatticeColourVector<Real, Nc> HoppingMatrix<Real, Nc, Nhops>::apply_odd_even(
+        const LatticeColourVector<Real, Nc>& fermion_in) const
+    {
+      LatticeColourVector<Real, Nc> fermion_out(
+          fermion_in.layout(), ColourVector<Real, Nc>::Zero(), num_spins_);
+      apply_odd_even(fermion_in, fermion_out);
+
+      return fermion_out;
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_full(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      check_fermions(fermion_in, fermion_out);
+      apply_sites(fermion_in, nullptr, nullptr, fermion_out);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_even_odd(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      check_fermions(fermion_in, fermion_out);
+      apply_sites(fermion_in, &even_array_indices_, nullptr, fermion_out);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_odd_even(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      check_fermions(fermion_in, fermion_out);
+      apply_sites(fermion_in, &odd_array_indices_, nullptr, fermion_out);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    std::vector<LatticeColourVector<Real, Nc>>
+    HoppingMatrix<Real, Nc, Nhops>::apply_full(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in) const
+    {
+      std::vector<LatticeColourVector<Real, Nc>> fermions_out;
+      fermions_out.reserve(fermions_in.size());
+      for (const auto& fermion_in : fermions_in) {
+        fermions_out.emplace_back(fermion_in.layout(), num_spins_);
+      }
+      apply_full(fermions_in, fermions_out);
+
+      return fermions_out;
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_full(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+    {
+      check_batch(fermions_in, fermions_out);
+      apply_sites(fermions_in, nullptr, nullptr, fermions_out);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_even_odd(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+    {
+      check_batch(fermions_in, fermions_out);
+      apply_sites(fermions_in, &even_array_indices_, nullptr, fermions_out);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_odd_even(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+    {
+      check_batch(fermions_in, fermions_out);
+      apply_sites(fermions_in, &odd_array_indices_, nullptr, fermions_out);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_checkerboard(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      apply_checkerboard(fermion_in, fermion_out, detail::NoEpilogue());
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_checkerboard(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+    {
+      apply_checkerboard(fermions_in, fermions_out, detail::NoEpilogue());
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    template <typename Epilogue>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_checkerboard(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out,
+        const Epilogue& epilogue) const
+    {
+      const auto parity = check_checkerboard(fermion_in, fermion_out);
+      const auto p = static_cast<unsigned int>(parity);
+      apply_sites(fermion_in, &cb_array_indices_[p],
+                  &cb_neighbour_indices_[p], fermion_out, epilogue);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    template <typename Epilogue>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_checkerboard(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+        const Epilogue& epilogue) const
+    {
+      if (fermions_in.size() != fermions_out.size()) {
+        throw std::invalid_argument(
+            "Input and output batches must contain the same number of "
+            "fermions");
+      }
+      if (fermions_in.empty()) {
+        return;
+      }
+
+      const auto parity = check_checkerboard(fermions_in[0], fermions_out[0]);
+      for (unsigned int k = 1; k < fermions_in.size(); ++k) {
+        if (check_checkerboard(fermions_in[k], fermions_out[k]) != parity) {
+          throw std::invalid_argument(
+              "Fermions in batch must share the same parity");
         }
       }
 
-      LatticeColourVector<Real, Nc> fermion_out(
-          layout, ColourVector<Real, Nc>::Zero(), num_spins_);
-
-#pragma omp parallel for
-      for (unsigned int i = 0; i < even_array_indices_.size(); ++i) {
-        auto arr_index = even_array_indices_[i];
-        for (unsigned mu = 0; mu < ndims; ++mu) {
-          auto neighbour_index_plus =
-              num_spins_ * (ndims * neighbour_array_indices_even_[i][2 * mu]
-                            + mu);
-          auto neighbour_index_minus =
-              num_spins_ * (ndims * neighbour_array_indices_even_[i][2 * mu + 1]
-                            + mu);
-          for (unsigned alpha = 0; alpha < num_spins_; ++alpha) {
-            Int gather_index_plus = 2 * (neighbour_index_plus + alpha);
-            Int gather_index_minus = 2 * (neighbour_index_minus + alpha);
-            fermion_out[num_spins_ * arr_index + alpha] +=
-                pre_gather_results[gather_index_minus];
-            fermion_out[num_spins_ * arr_index + alpha] +=
-                pre_gather_results[gather_index_plus + 1];
-          }
+      const auto p = static_cast<unsigned int>(parity);
+      apply_sites(fermions_in, &cb_array_indices_[p],
+                  &cb_neighbour_indices_[p], fermions_out, epilogue);
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    Parity HoppingMatrix<Real, Nc, Nhops>::check_checkerboard(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        const LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      if (cb_array_indices_[0].empty()) {
+        throw std::invalid_argument(
+            "Checkerboarded fermions require all lattice extents to be even");
+      }
+
+      const auto& layout_in = checkerboard_layout(fermion_in);
+      const auto& layout_out = checkerboard_layout(fermion_out);
+
+      if (layout_in.full_layout().volume() != num_sites() or
+          layout_out.full_layout().volume() != num_sites() or
+          fermion_in.site_size() != num_spins_ or
+          fermion_out.site_size() != num_spins_) {
+        throw std::invalid_argument(
+            "Fermion doesn't match hopping matrix lattice");
+      }
+
+      const bool flips_parity = Nhops % 2 == 1;
+      if ((layout_in.parity() != layout_out.parity()) != flips_parity) {
+        throw std::invalid_argument(
+            "Input fermion has the wrong parity for output fermion");
+      }
+
+      return layout_out.parity();
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::check_fermions(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        const LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      // The kernels index the fermions without bounds checks, so both must
+      // cover the lattice of the hopping matrix
+      const auto size = static_cast<unsigned long>(num_sites()) * num_spins_;
+
+      if (fermion_in.size() != size or fermion_out.size() != size) {
+        throw std::invalid_argument(
+            "Fermion doesn't match hopping matrix lattice");
+      }
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    void HoppingMatrix<Real, Nc, Nhops>::check_batch(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+    {
+      if (fermions_in.size() != fermions_out.size()) {
+        throw std::invalid_argument(
+            "Input and output batches must contain the same number of "
+            "fermions");
+      }
+
+      const auto size = static_cast<unsigned long>(num_sites()) * num_spins_;
+
+      for (unsigned int k = 0; k < fermions_in.size(); ++k) {
+        if (fermions_in[k].size() != size or fermions_out[k].size() != size) {
+          throw std::invalid_argument(
+              "Fermion in batch doesn't match hopping matrix lattice");
         }
       }
+    }
 
-      return fermion_out;
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    template <typename Fermions, typename Epilogue>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_sites(
+        const Fermions& fermion_in,
+        const std::vector<Int>* arr_indices,
+        const std::vector<Int>* cb_neighbours,
+        Fermions& fermion_out, const Epilogue& epilogue) const
+    {
+      // Select the kernel for the spin structures and the link storage
+      // format once, outside the loop over sites.
+      if (spin_kernel_ == SpinKernel::Wilson) {
+        apply_sites(fermion_in, arr_indices, cb_neighbours, fermion_out,
+                    epilogue, detail::SpinKernelTag<SpinKernel::Wilson>());
+      }
+      else {
+        apply_sites(fermion_in, arr_indices, cb_neighbours, fermion_out,
+                    epilogue, detail::SpinKernelTag<SpinKernel::Table>());
+      }
     }
 
 
     template <typename Real, int Nc, unsigned int Nhops>
-    LatticeColourVector<Real, Nc> HoppingMatrix<Real, Nc, Nhops>::apply_odd_even(
-        const LatticeColourVector<Real, Nc>& fermion_in) const
+    template <typename Fermions, typename Epilogue, SpinKernel Kernel>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_sites(
+        const Fermions& fermion_in,
+        const std::vector<Int>* arr_indices,
+        const std::vector<Int>* cb_neighbours,
+        Fermions& fermion_out, const Epilogue& epilogue,
+        detail::SpinKernelTag<Kernel>) const
     {
-      auto& layout = fermion_in.layout();
-      auto ndims = layout.num_dims();
-      auto volume = layout.volume();
-      aligned_vector<ColourVector<Real, Nc>> pre_gather_results(
-          volume * ndims * num_spins_, ColourVector<Real, Nc>::Zero());
-
-      for (unsigned int i = 0; i < even_array_indices_.size(); ++i) {
-        auto arr_index = even_array_indices_[i];
-        for (unsigned mu = 0; mu < ndims; ++mu) {
-          Int gather_index = 2 * (ndims * i + mu);
-          Int local_index = 2 * (ndims * arr_index + mu);
-          for (unsigned alpha = 0; alpha < num_spins_; ++alpha) {
-            for (unsigned beta = 0; beta < num_spins_; ++beta) {
-              pre_gather_results[num_spins_ * gather_index + 2 * alpha] +=
-                  spin_structures_[2 * mu].coeff(alpha, beta) *
-                  scattered_gauge_field_[local_index] *
-                  fermion_in[num_spins_ * arr_index + beta];
-              pre_gather_results[num_spins_ * gather_index + 2 * alpha + 1] +=
-                  spin_structures_[2 * mu + 1].coeff(alpha, beta) *
-                  scattered_gauge_field_[local_index + 1].adjoint() *
-                  fermion_in[num_spins_ * arr_index + beta];
-            }
-          }
+      switch (compression_) {
+      case LinkCompression::None:
+        apply_sites<LinkCompression::None, Kernel>(
+            fermion_in, arr_indices, cb_neighbours, fermion_out, epilogue);
+        break;
+      case LinkCompression::TwelveReal:
+        apply_sites<LinkCompression::TwelveReal, Kernel>(
+            fermion_in, arr_indices, cb_neighbours, fermion_out, epilogue);
+        break;
+      case LinkCompression::EightReal:
+        apply_sites<LinkCompression::EightReal, Kernel>(
+            fermion_in, arr_indices, cb_neighbours, fermion_out, epilogue);
+        break;
+      }
+    }
+
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    template <LinkCompression Compression, SpinKernel Kernel,
+              typename Epilogue>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_sites(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        const std::vector<Int>* arr_indices,
+        const std::vector<Int>* cb_neighbours,
+        LatticeColourVector<Real, Nc>& fermion_out,
+        const Epilogue& epilogue) const
+    {
+      const Int num_indices =
+          arr_indices == nullptr ? num_sites() : arr_indices->size();
+
+      const bool compressed = Compression != LinkCompression::None;
+
+#pragma omp parallel
+      {
+        aligned_vector<ColourMatrix<Real, Nc>> link_buffer(
+            compressed ? 2 * num_dims_ : 0);
+
+#pragma omp for
+        for (Int i = 0; i < num_indices; ++i) {
+          const Int arr_index =
+              arr_indices == nullptr ? i : (*arr_indices)[i];
+          const auto links = load_links(arr_index, link_buffer.data(),
+                                        detail::CompressionTag<Compression>());
+          apply_site<Compression, Kernel>(fermion_in, i, arr_index, links,
+                                          cb_neighbours, 0, epilogue,
+                                          fermion_out);
         }
       }
+    }
 
-      LatticeColourVector<Real, Nc> fermion_out(
-          layout, ColourVector<Real, Nc>::Zero(), num_spins_);
-
-#pragma omp parallel for
-      for (unsigned int i = 0; i < odd_array_indices_.size(); ++i) {
-        auto arr_index = odd_array_indices_[i];
-        for (unsigned mu = 0; mu < ndims; ++mu) {
-          auto neighbour_index_plus =
-              num_spins_ * (ndims * neighbour_array_indices_odd_[i][2 * mu]
-                            + mu);
-          auto neighbour_index_minus =
-              num_spins_ * (ndims * neighbour_array_indices_odd_[i][2 * mu + 1]
-                            + mu);
-          for (unsigned alpha = 0; alpha < num_spins_; ++alpha) {
-            Int gather_index_plus = 2 * (neighbour_index_plus + alpha);
-            Int gather_index_minus = 2 * (neighbour_index_minus + alpha);
-            fermion_out[num_spins_ * arr_index + alpha] +=
-                pre_gather_results[gather_index_minus];
-            fermion_out[num_spins_ * arr_index + alpha] +=
-                pre_gather_results[gather_index_plus + 1];
+
+    template <typename Real, int Nc, unsigned int Nhops>
+    template <LinkCompression Compression, SpinKernel Kernel,
+              typename Epilogue>
+    void HoppingMatrix<Real, Nc, Nhops>::apply_sites(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        const std::vector<Int>* arr_indices,
+        const std::vector<Int>* cb_neighbours,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+        const Epilogue& epilogue) const
+    {
+      const Int num_indices =
+          arr_indices == nullptr ? num_sites() : arr_indices->size();
+      const Int num_tiles =
+          (num_indices + batch_tile_size - 1) / batch_tile_size;
+      const auto batch_size = fermions_in.size();
+
+      const bool compressed = Compression != LinkCompression::None;
+
+#pragma omp parallel
+      {
+        // Links for the current tile, which are reconstructed once and then
+        // reused for every fermion in the batch
+        aligned_vector<ColourMatrix<Real, Nc>> link_buffer(
+            compressed ? batch_tile_size * 2 * num_dims_ : 0);
+        std::array<Int, batch_tile_size> tile_arr_indices;
+        std::array<const ColourMatrix<Real, Nc>*, batch_tile_size> tile_links;
+
+#pragma omp for
+        for (Int tile = 0; tile < num_tiles; ++tile) {
+          const Int begin = tile * batch_tile_size;
+          const Int end = std::min(begin + batch_tile_size, num_indices);
+
+          for (Int i = begin; i < end; ++i) {
+            const Int arr_index =
+                arr_indices == nullptr ? i : (*arr_indices)[i];
+            ColourMatrix<Real, Nc>* buffer =
+                compressed ? &link_buffer[2 * num_dims_ * (i - begin)] :
+                nullptr;
+            tile_arr_indices[i - begin] = arr_index;
+            tile_links[i - begin] = load_links(
+                arr_index, buffer, detail::CompressionTag<Compression>());
+          }
+
+          for (unsigned int k = 0; k < batch_size; ++k) {
+            for (Int i = begin; i < end; ++i) {
+              apply_site<Compression, Kernel>(
+                  fermions_in[k], i, tile_arr_indices[i - begin],
+                  tile_links[i - begin], cb_neighbours, k, epilogue,
+                  fermions_out[k]);
+            }
           }
         }
       }
-
-      return fermion_out;
     }
   }
 }
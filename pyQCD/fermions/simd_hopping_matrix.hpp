@@ -0,0 +1,274 @@
+#ifndef PYQCD_SIMD_HOPPING_MATRIX_HPP
+#define PYQCD_SIMD_HOPPING_MATRIX_HPP
+
+/*
+ * This file is part of pyQCD.
+ *
+ * pyQCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * pyQCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *
+ * Implementation of the nearest-neighbour hopping matrix for fermions stored
+ * on a VirtualNodeLayout.
+ *
+ * Each element of a vectorised fermion holds Lanes sites, one from each
+ * virtual node, all at the same position within their node. Hops within a
+ * node are therefore the same for every lane. Hops that leave a node arrive
+ * at the opposite face of the neighbouring node, which corresponds to moving
+ * to the wrapped position within the node and rotating the lanes along the
+ * relevant dimension.
+ */
+
+#include <array>
+
+#include <core/simd_types.hpp>
+
+#include "hopping_matrix.hpp"
+
+
+namespace pyQCD
+{
+  namespace fermions
+  {
+    template <typename Real, int Nc, int Lanes>
+    class SimdHoppingMatrix
+    {
+    public:
+      using Fermion = LatticeSimdColourVector<Real, Nc, Lanes>;
+
+      SimdHoppingMatrix(const LatticeColourMatrix<Real, Nc>& gauge_field,
+                        const std::vector<std::complex<Real>>& phases,
+                        const std::vector<SpinMatrix<Real>>& spin_structures,
+                        const VirtualNodeLayout& layout);
+
+      unsigned int num_spins() const { return num_spins_; }
+
+      Fermion apply_full(const Fermion& in) const;
+      // The output must not alias the input
+      void apply_full(const Fermion& in, Fermion& out) const;
+
+    private:
+      using SpinEntry = typename SpinProjectionTable<Real>::Entry;
+      using LanePermutation = std::array<int, Lanes>;
+
+      void apply_site(const Fermion& fermion_in, const Int outer_index,
+                      Fermion& fermion_out) const;
+
+      const VirtualNodeLayout* layout_;
+      unsigned int num_dims_, num_spins_, num_half_spins_;
+      // Links used to hop onto each site, arranged as for the scattered gauge
+      // field in HoppingMatrix, with boundary phases folded in.
+      LatticeSimdColourMatrix<Real, Nc, Lanes> scattered_gauge_field_;
+      std::vector<std::vector<SpinEntry>> projector_entries_;
+      std::vector<std::vector<SpinEntry>> reconstructor_entries_;
+      // Outer indices of the neighbours of each outer site, along with flags
+      // denoting whether the lanes must be permuted for each hop.
+      std::vector<Int> neighbour_outer_indices_;
+      std::vector<unsigned char> permute_lanes_;
+      // Lane permutation for each hop direction
+      std::vector<LanePermutation> lane_permutations_;
+    };
+
+
+    template <typename Real, int Nc, int Lanes>
+    SimdHoppingMatrix<Real, Nc, Lanes>::SimdHoppingMatrix(
+        const LatticeColourMatrix<Real, Nc>& gauge_field,
+        const std::vector<std::complex<Real>>& phases,
+        const std::vector<SpinMatrix<Real>>& spin_structures,
+        const VirtualNodeLayout& layout)
+      : layout_(&layout), num_dims_(layout.num_dims()),
+        num_spins_(
+          static_cast<unsigned int>(std::pow(2, layout.num_dims() / 2))),
+        scattered_gauge_field_(layout.outer_layout(), 2 * layout.num_dims())
+    {
+      if (layout.num_lanes() != Lanes) {
+        throw std::invalid_argument(
+            "Number of SIMD lanes doesn't match VirtualNodeLayout");
+      }
+
+      SpinProjectionTable<Real> table(spin_structures, num_spins_);
+      num_half_spins_ = table.num_half_spins;
+      projector_entries_ = std::move(table.projector_entries);
+      reconstructor_entries_ = std::move(table.reconstructor_entries);
+
+      const auto& outer_layout = layout.outer_layout();
+      const auto& outer_shape = layout.outer_shape();
+      const auto& lane_shape = layout.lane_shape();
+      const auto outer_volume = outer_layout.volume();
+      const auto& shape = layout.shape();
+
+      // Lane permutations. The lane index is the lexicographic index of the
+      // virtual node, so hopping forward by one node in dimension d means
+      // lane l takes its value from the node at lane_coords + e_d.
+      lane_permutations_.resize(2 * num_dims_);
+      for (unsigned d = 0; d < num_dims_; ++d) {
+        for (int lane = 0; lane < Lanes; ++lane) {
+          Site lane_coords(num_dims_);
+          Int remainder = lane;
+          for (int i = num_dims_ - 1; i > -1; --i) {
+            lane_coords[i] = remainder % lane_shape[i];
+            remainder /= lane_shape[i];
+          }
+
+          for (unsigned hop = 0; hop < 2; ++hop) {
+            auto coords = lane_coords;
+            coords[d] = (coords[d] + (hop == 0 ? 1 : lane_shape[d] - 1))
+                        % lane_shape[d];
+            int source_lane = 0;
+            for (unsigned i = 0; i < num_dims_; ++i) {
+              source_lane = source_lane * lane_shape[i] + coords[i];
+            }
+            lane_permutations_[2 * d + hop][lane] = source_lane;
+          }
+        }
+      }
+
+      neighbour_outer_indices_.resize(2 * num_dims_ * outer_volume);
+      permute_lanes_.resize(2 * num_dims_ * outer_volume);
+
+      for (Int outer_index = 0; outer_index < outer_volume; ++outer_index) {
+        const auto outer_coords = outer_layout.compute_site_coords(outer_index);
+
+        for (unsigned d = 0; d < num_dims_; ++d) {
+          const Int link_index = 2 * (num_dims_ * outer_index + d);
+          auto coords = outer_coords;
+
+          coords[d] = (outer_coords[d] + 1) % outer_shape[d];
+          neighbour_outer_indices_[link_index] =
+              outer_layout.get_array_index(coords);
+          permute_lanes_[link_index] =
+              lane_shape[d] > 1 and outer_coords[d] + 1 == outer_shape[d];
+
+          coords[d] = (outer_coords[d] + outer_shape[d] - 1) % outer_shape[d];
+          neighbour_outer_indices_[link_index + 1] =
+              outer_layout.get_array_index(coords);
+          permute_lanes_[link_index + 1] =
+              lane_shape[d] > 1 and outer_coords[d] == 0;
+        }
+      }
+
+      // Gather the links required to hop onto each site, lane by lane.
+      for (Int site_index = 0; site_index < layout.volume(); ++site_index) {
+        const Int arr_index = layout.get_array_index(site_index);
+        const Int outer_index = arr_index / Lanes;
+        const int lane = arr_index % Lanes;
+        const auto site_coords = layout.compute_site_coords(site_index);
+
+        for (unsigned d = 0; d < num_dims_; ++d) {
+          const auto phase_fwd = (site_coords[d] + 1 == shape[d]) ?
+                                 phases[d] : std::complex<Real>(1.0);
+          const auto phase_bck = (site_coords[d] == 0) ?
+                                 phases[d] : std::complex<Real>(1.0);
+
+          auto coords = site_coords;
+          coords[d] = (site_coords[d] + shape[d] - 1) % shape[d];
+
+          const ColourMatrix<Real, Nc> link_fwd =
+              phase_fwd * gauge_field(site_coords, d);
+          const ColourMatrix<Real, Nc> link_bck =
+              (phase_bck * gauge_field(coords, d)).adjoint();
+
+          auto& simd_link_fwd =
+              scattered_gauge_field_(outer_index, 2 * d);
+          auto& simd_link_bck =
+              scattered_gauge_field_(outer_index, 2 * d + 1);
+
+          for (int i = 0; i < Nc; ++i) {
+            for (int j = 0; j < Nc; ++j) {
+              simd_link_fwd(i, j).set_lane(lane, link_fwd(i, j));
+              simd_link_bck(i, j).set_lane(lane, link_bck(i, j));
+            }
+          }
+        }
+      }
+    }
+
+
+    template <typename Real, int Nc, int Lanes>
+    inline void SimdHoppingMatrix<Real, Nc, Lanes>::apply_site(
+        const Fermion& fermion_in, const Int outer_index,
+        Fermion& fermion_out) const
+    {
+      // As HoppingMatrix::apply_site, except that each half-spinor is rotated
+      // across the lanes where the hop leaves the virtual node.
+      const Int out_offset = num_spins_ * outer_index;
+
+      for (unsigned int alpha = 0; alpha < num_spins_; ++alpha) {
+        fermion_out[out_offset + alpha].setZero();
+      }
+
+      SimdColourVector<Real, Nc, Lanes> half_spinor;
+      SimdColourVector<Real, Nc, Lanes> transported;
+
+      for (unsigned int hop = 0; hop < 2 * num_dims_; ++hop) {
+        const Int link_index = 2 * num_dims_ * outer_index + hop;
+        const Int in_offset =
+            num_spins_ * neighbour_outer_indices_[link_index];
+        const bool permute = permute_lanes_[link_index];
+        const auto& link = scattered_gauge_field_[link_index];
+
+        auto proj_entry = projector_entries_[hop].begin();
+        const auto proj_end = projector_entries_[hop].end();
+        auto recon_entry = reconstructor_entries_[hop].begin();
+        const auto recon_end = reconstructor_entries_[hop].end();
+
+        for (unsigned int a = 0; a < num_half_spins_; ++a) {
+          half_spinor.setZero();
+          for (; proj_entry != proj_end and proj_entry->row == a;
+               ++proj_entry) {
+            half_spinor.add_scaled(proj_entry->coeff,
+                                   fermion_in[in_offset + proj_entry->col]);
+          }
+
+          if (permute) {
+            half_spinor = half_spinor.permute(lane_permutations_[hop]);
+          }
+
+          transported.setZero();
+          multiply_add(link, half_spinor, transported);
+
+          for (; recon_entry != recon_end and recon_entry->col == a;
+               ++recon_entry) {
+            fermion_out[out_offset + recon_entry->row].add_scaled(
+                recon_entry->coeff, transported);
+          }
+        }
+      }
+    }
+
+
+    template <typename Real, int Nc, int Lanes>
+    LatticeSimdColourVector<Real, Nc, Lanes>
+    SimdHoppingMatrix<Real, Nc, Lanes>::apply_full(const Fermion& in) const
+    {
+      Fermion out(in.layout(), num_spins_);
+      apply_full(in, out);
+      return out;
+    }
+
+
+    template <typename Real, int Nc, int Lanes>
+    void SimdHoppingMatrix<Real, Nc, Lanes>::apply_full(
+        const Fermion& in, Fermion& out) const
+    {
+      const auto outer_volume = layout_->outer_layout().volume();
+
+#pragma omp parallel for
+      for (unsigned outer_index = 0; outer_index < outer_volume;
+           ++outer_index) {
+        apply_site(in, outer_index, out);
+      }
+    }
+  }
+}
+
+#endif //PYQCD_SIMD_HOPPING_MATRIX_HPP
@@ -37,7 +37,12 @@ namespace pyQCD
     public:
       WilsonAction(const Real mass,
                    const LatticeColourMatrix<Real, Nc>& gauge_field,
-                   const std::vector<Real>& boundary_phases);
+                   const std::vector<Real>& boundary_phases,
+                   const LinkCompression compression = LinkCompression::None);
+      // Create a copy of an action with a different precision, e.g. for use
+      // in mixed-precision solvers
+      template <typename OtherReal>
+      explicit WilsonAction(const WilsonAction<OtherReal, Nc>& other);
 
       LatticeColourVector<Real, Nc> apply_full(
           const LatticeColourVector<Real, Nc>& fermion_in) const override;
@@ -55,40 +60,179 @@ namespace pyQCD
       LatticeColourVector<Real, Nc> remove_hermiticity(
           const LatticeColourVector<Real, Nc>& fermion) const override;
 
+      void apply_full(const LatticeColourVector<Real, Nc>& fermion_in,
+                      LatticeColourVector<Real, Nc>& fermion_out) const override;
+      void apply_full(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out
+      ) const override;
+      void apply_even_odd(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out
+      ) const override;
+      void apply_odd_even(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out
+      ) const override;
+      void apply_even_even_inv(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const override;
+      void apply_odd_odd(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const override;
+      void apply_even_odd(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const override;
+      void apply_odd_even(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const override;
+
+      void apply_hermiticity(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const override;
+      void remove_hermiticity(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const override;
+
+      void apply_hopping_checkerboard(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const override
+      {
+        this->check_distinct(fermion_in, fermion_out);
+        hopping_matrix_.apply_checkerboard(fermion_in, fermion_out);
+      }
+      void apply_hopping_checkerboard(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out
+      ) const override
+      {
+        this->check_distinct(fermions_in, fermions_out);
+        hopping_matrix_.apply_checkerboard(fermions_in, fermions_out);
+      }
+      void apply_even_even_inv_checkerboard(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const override
+      {
+        this->check_distinct(fermion_in, fermion_out);
+        fermion_out = fermion_in / (4 + this->mass_);
+      }
+      void apply_odd_odd_checkerboard(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const override
+      {
+        this->check_distinct(fermion_in, fermion_out);
+        fermion_out = (4 + this->mass_) * fermion_in;
+      }
+
+      void apply_schur(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out,
+          Workspace<Real, Nc>& workspace) const override
+      { apply_schur_fused(fermion_in, fermion_out, workspace, false); }
+      void apply_schur(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+          Workspace<Real, Nc>& workspace) const override
+      { apply_schur_fused(fermions_in, fermions_out, workspace, false); }
+      void apply_schur_hermitian(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out,
+          Workspace<Real, Nc>& workspace) const override
+      { apply_schur_fused(fermion_in, fermion_out, workspace, true); }
+      void apply_schur_hermitian(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+          Workspace<Real, Nc>& workspace) const override
+      { apply_schur_fused(fermions_in, fermions_out, workspace, true); }
+
     private:
+      template <typename OtherReal, int OtherNc>
+      friend class WilsonAction;
+
+      void init_chiral_gamma();
+
       std::vector<SpinMatrix<Real>> generate_spin_structures(
           const unsigned int num_dims) const;
 
-      LatticeColourVector<Real, Nc> multiply_chiral_gamma(
-          const LatticeColourVector<Real, Nc>& fermion) const;
+      void multiply_chiral_gamma(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out) const;
+
+      // Fused implementations of apply_schur and apply_schur_hermitian
+      void apply_schur_fused(
+          const LatticeColourVector<Real, Nc>& fermion_in,
+          LatticeColourVector<Real, Nc>& fermion_out,
+          Workspace<Real, Nc>& workspace, const bool hermitian) const;
+      void apply_schur_fused(
+          const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+          std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+          Workspace<Real, Nc>& workspace, const bool hermitian) const;
+      const Real* schur_spin_scales(
+          const LatticeColourVector<Real, Nc>& fermion,
+          const bool hermitian) const
+      {
+        return hermitian and fermion.num_dims() % 2 == 0 ?
+               chiral_signs_.data() : nullptr;
+      }
 
       HoppingMatrix<Real, Nc, 1> hopping_matrix_;
       SpinMatrix<Real> chiral_gamma_;
+      // Diagonal of chiral_gamma_
+      std::vector<Real> chiral_signs_;
     };
 
 
     template <typename Real, int Nc>
     WilsonAction<Real, Nc>::WilsonAction(
         const Real mass, const LatticeColourMatrix<Real, Nc>& gauge_field,
-        const std::vector<Real>& boundary_phases)
+        const std::vector<Real>& boundary_phases,
+        const LinkCompression compression)
       : Action<Real, Nc>(mass, boundary_phases),
         hopping_matrix_(
             gauge_field, this->phases_,
-            std::move(generate_spin_structures(gauge_field.num_dims())))
+            std::move(generate_spin_structures(gauge_field.num_dims())),
+            compression)
+    {
+      init_chiral_gamma();
+    }
+
+
+    template <typename Real, int Nc>
+    template <typename OtherReal>
+    WilsonAction<Real, Nc>::WilsonAction(
+        const WilsonAction<OtherReal, Nc>& other)
+      : Action<Real, Nc>(
+          static_cast<Real>(other.mass()),
+          std::vector<std::complex<Real>>(other.phases().begin(),
+                                          other.phases().end())),
+        hopping_matrix_(other.hopping_matrix_)
+    {
+      init_chiral_gamma();
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::init_chiral_gamma()
     {
       long num_spins = hopping_matrix_.num_spins();
 
       chiral_gamma_ = SpinMatrix<Real>::Identity(num_spins, num_spins);
       chiral_gamma_.bottomRightCorner(num_spins / 2, num_spins / 2)
           = -SpinMatrix<Real>::Identity(num_spins / 2, num_spins / 2);
+
+      chiral_signs_.resize(num_spins);
+      for (long alpha = 0; alpha < num_spins; ++alpha) {
+        chiral_signs_[alpha] = std::real(chiral_gamma_.coeff(alpha, alpha));
+      }
     }
 
     template <typename Real, int Nc>
     LatticeColourVector<Real, Nc> WilsonAction<Real, Nc>::apply_full(
         const LatticeColourVector<Real, Nc>& fermion_in) const
     {
-      auto fermion_out = hopping_matrix_.apply_full(fermion_in);
-      fermion_out += fermion_in * (4.0 + this->mass_);
+      LatticeColourVector<Real, Nc> fermion_out(
+          fermion_in.layout(), fermion_in.site_size());
+      apply_full(fermion_in, fermion_out);
       return fermion_out;
     }
 
@@ -100,11 +244,7 @@ namespace pyQCD
       LatticeColourVector<Real, Nc> fermion_out(
           fermion_in.layout(), ColourVector<Real, Nc>::Zero(),
           fermion_in.site_size());
-
-      auto half_vol = fermion_in.volume() / 2;
-      fermion_out.segment(0, half_vol) =
-          fermion_in.segment(0, half_vol) / (4.0 + this->mass_);
-
+      apply_even_even_inv(fermion_in, fermion_out);
       return fermion_out;
     }
 
@@ -116,11 +256,7 @@ namespace pyQCD
       LatticeColourVector<Real, Nc> fermion_out(
           fermion_in.layout(), ColourVector<Real, Nc>::Zero(),
           fermion_in.site_size());
-
-      auto half_vol = fermion_in.volume() / 2;
-      fermion_out.segment(half_vol, half_vol) =
-          (4.0 + this->mass_) * fermion_in.segment(half_vol, half_vol);
-
+      apply_odd_odd(fermion_in, fermion_out);
       return fermion_out;
     }
 
@@ -142,50 +278,225 @@ namespace pyQCD
 
 
     template <typename Real, int Nc>
-    LatticeColourVector<Real, Nc> WilsonAction<Real, Nc>::multiply_chiral_gamma(
+    LatticeColourVector<Real, Nc> WilsonAction<Real, Nc>::apply_hermiticity(
         const LatticeColourVector<Real, Nc>& fermion) const
     {
-      Int volume = fermion.volume();
-      Int nspins = hopping_matrix_.num_spins();
+      LatticeColourVector<Real, Nc> fermion_out(
+          fermion.layout(), fermion.site_size());
+      apply_hermiticity(fermion, fermion_out);
+      return fermion_out;
+    }
 
-      LatticeColourVector<Real, Nc> ret(
-          fermion.layout(), ColourVector<Real, Nc>::Zero(), fermion.site_size());
 
-      for (Int site_index = 0; site_index < volume; ++site_index) {
+    template <typename Real, int Nc>
+    LatticeColourVector<Real, Nc> WilsonAction<Real, Nc>::remove_hermiticity(
+        const LatticeColourVector<Real, Nc>& fermion) const
+    {
+      LatticeColourVector<Real, Nc> fermion_out(
+          fermion.layout(), fermion.site_size());
+      remove_hermiticity(fermion, fermion_out);
+      return fermion_out;
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_full(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      this->check_distinct(fermion_in, fermion_out);
+      hopping_matrix_.apply_full(fermion_in, fermion_out);
+      fermion_out += fermion_in * (4 + this->mass_);
+    }
+
 
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_full(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+    {
+      this->check_distinct(fermions_in, fermions_out);
+      hopping_matrix_.apply_full(fermions_in, fermions_out);
+      for (unsigned int k = 0; k < fermions_in.size(); ++k) {
+        fermions_out[k] += fermions_in[k] * (4 + this->mass_);
+      }
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_even_even_inv(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      this->check_distinct(fermion_in, fermion_out);
+      auto half_vol = fermion_in.volume() / 2;
+      fermion_out.segment(0, half_vol) =
+          fermion_in.segment(0, half_vol) / (4 + this->mass_);
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_odd_odd(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      this->check_distinct(fermion_in, fermion_out);
+      auto half_vol = fermion_in.volume() / 2;
+      fermion_out.segment(half_vol, half_vol) =
+          (4 + this->mass_) * fermion_in.segment(half_vol, half_vol);
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_even_odd(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      this->check_distinct(fermion_in, fermion_out);
+      hopping_matrix_.apply_even_odd(fermion_in, fermion_out);
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_odd_even(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      this->check_distinct(fermion_in, fermion_out);
+      hopping_matrix_.apply_odd_even(fermion_in, fermion_out);
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_even_odd(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+    {
+      this->check_distinct(fermions_in, fermions_out);
+      hopping_matrix_.apply_even_odd(fermions_in, fermions_out);
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_odd_even(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out) const
+    {
+      this->check_distinct(fermions_in, fermions_out);
+      hopping_matrix_.apply_odd_even(fermions_in, fermions_out);
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::multiply_chiral_gamma(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      // The chiral gamma matrix is diagonal in this basis, so each spin
+      // component can be scaled independently. This also means fermion_in and
+      // fermion_out may refer to the same object.
+      const Int volume = fermion_in.volume();
+      const Int nspins = hopping_matrix_.num_spins();
+
+#pragma omp parallel for
+      for (Int site_index = 0; site_index < volume; ++site_index) {
         for (Int alpha = 0; alpha < nspins; ++alpha) {
-          for (Int beta = 0; beta < nspins; ++beta) {
-            ret[nspins * site_index + alpha] += chiral_gamma_.coeff(alpha, beta)
-                           * fermion[nspins * site_index + beta];
-          }
+          const Int i = nspins * site_index + alpha;
+          fermion_out[i] = chiral_gamma_.coeff(alpha, alpha) * fermion_in[i];
         }
       }
+    }
+
 
-      return ret;
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_schur_fused(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out,
+        Workspace<Real, Nc>& workspace, const bool hermitian) const
+    {
+      // M_ee^-1 is just 1 / (4 + m) for Wilson fermions, so the Schur
+      // complement can be computed in two sweeps over the lattice, with the
+      // diagonal terms (and gamma_5, for the hermitian form) applied to each
+      // site as soon as its hopping term is computed:
+      //   t_e = M_eo x_o / (4 + m)
+      //   y_o = gamma_5 ((4 + m) x_o - M_oe t_e)
+      // The second sweep reads x_o at each output site after zeroing it, so
+      // fermion_out must not alias fermion_in.
+      this->check_distinct(fermion_in, fermion_out);
+      const auto& even_layout = this->odd_checkerboard(fermion_in).opposite();
+      auto& temp = workspace.fermion(0, even_layout, fermion_in.site_size());
+      const Real diag = 4 + this->mass_;
+      const auto spin_scales = schur_spin_scales(fermion_in, hermitian);
+
+      hopping_matrix_.apply_checkerboard(
+          fermion_in, temp,
+          ScaleAddEpilogue<Real, Nc>{1 / diag, nullptr, 0, nullptr});
+      hopping_matrix_.apply_checkerboard(
+          temp, fermion_out,
+          ScaleAddEpilogue<Real, Nc>{-1, &fermion_in, diag, spin_scales});
     }
 
+
     template <typename Real, int Nc>
-    LatticeColourVector<Real, Nc> WilsonAction<Real, Nc>::apply_hermiticity(
-        const LatticeColourVector<Real, Nc>& fermion) const
+    void WilsonAction<Real, Nc>::apply_schur_fused(
+        const std::vector<LatticeColourVector<Real, Nc>>& fermions_in,
+        std::vector<LatticeColourVector<Real, Nc>>& fermions_out,
+        Workspace<Real, Nc>& workspace, const bool hermitian) const
     {
-      if (fermion.num_dims() % 2 == 1) {
+      // As above, but using the batched hopping matrix
+      this->check_distinct(fermions_in, fermions_out);
+      if (fermions_in.empty()) {
+        return;
+      }
+
+      const auto& front = fermions_in.front();
+      const auto& even_layout = this->odd_checkerboard(front).opposite();
+      auto& temps = workspace.batch(
+          0, even_layout, front.site_size(),
+          static_cast<unsigned int>(fermions_in.size()));
+      const Real diag = 4 + this->mass_;
+      const auto spin_scales = schur_spin_scales(front, hermitian);
+
+      hopping_matrix_.apply_checkerboard(
+          fermions_in, temps,
+          ScaleAddEpilogue<Real, Nc>{1 / diag, nullptr, 0, nullptr});
+      hopping_matrix_.apply_checkerboard(
+          temps, fermions_out,
+          ScaleAddEpilogue<Real, Nc>{
+              -1, fermions_in.data(), diag, spin_scales});
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::apply_hermiticity(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
+    {
+      if (fermion_in.num_dims() % 2 == 1) {
         // TODO: Implement handling of odd number of dimensions
-        return fermion;
+        if (&fermion_out != &fermion_in) {
+          fermion_out = fermion_in;
+        }
+        return;
       }
 
-      return multiply_chiral_gamma(fermion);
+      multiply_chiral_gamma(fermion_in, fermion_out);
     }
 
 
     template <typename Real, int Nc>
-    LatticeColourVector<Real, Nc> WilsonAction<Real, Nc>::remove_hermiticity(
-        const LatticeColourVector<Real, Nc>& fermion) const
+    void WilsonAction<Real, Nc>::remove_hermiticity(
+        const LatticeColourVector<Real, Nc>& fermion_in,
+        LatticeColourVector<Real, Nc>& fermion_out) const
     {
-      if (fermion.num_dims() % 2 == 1) {
-        return fermion;
+      if (fermion_in.num_dims() % 2 == 1) {
+        if (&fermion_out != &fermion_in) {
+          fermion_out = fermion_in;
+        }
+        return;
       }
 
-      return multiply_chiral_gamma(fermion);
+      multiply_chiral_gamma(fermion_in, fermion_out);
     }
 
 
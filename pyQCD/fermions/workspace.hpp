@@ -0,0 +1,169 @@
+#ifndef PYQCD_FERMION_WORKSPACE_HPP
+#define PYQCD_FERMION_WORKSPACE_HPP
+/*
+ * This file is part of pyQCD.
+ *
+ * pyQCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * pyQCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *
+ * Storage for temporary fermion fields used when applying fermion operators.
+ * Solvers hold a Workspace for the duration of a solve so that the temporaries
+ * required by composite operators are only allocated once.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <core/qcd_types.hpp>
+
+
+namespace pyQCD
+{
+  namespace fermions
+  {
+    template <typename Real, int Nc>
+    class Workspace
+    {
+    public:
+      using Fermion = LatticeColourVector<Real, Nc>;
+
+      Workspace() = default;
+      Workspace(const Workspace<Real, Nc>&) = delete;
+      Workspace(Workspace<Real, Nc>&&) = default;
+
+      Fermion& fermion(const unsigned int index, const Fermion& like)
+      { return fermion(index, like.layout(), like.site_size()); }
+      // As above, but for a fermion with the specified layout and site size,
+      // e.g. a fermion on the opposite checkerboard to some other fermion.
+      Fermion& fermion(const unsigned int index, const Layout& layout,
+                       const Int site_size);
+      // As above, but for a batch of fermions with the same size as like.
+      // Batches are indexed independently of the single fermions.
+      std::vector<Fermion>& batch(const unsigned int index,
+                                  const std::vector<Fermion>& like);
+      std::vector<Fermion>& batch(const unsigned int index,
+                                  const Layout& layout, const Int site_size,
+                                  const unsigned int size);
+
+    private:
+      static bool matches(const Fermion& fermion, const Layout& layout,
+                          const Int site_size)
+      {
+        return &fermion.layout() == &layout and
+               fermion.site_size() == site_size;
+      }
+
+      std::vector<std::unique_ptr<Fermion>> fermions_;
+      std::vector<std::unique_ptr<std::vector<Fermion>>> batches_;
+    };
+
+
+    template <typename Real, int Nc>
+    LatticeColourVector<Real, Nc>& Workspace<Real, Nc>::fermion(
+        const unsigned int index, const Layout& layout, const Int site_size)
+    {
+      // Return the temporary fermion with the given index, (re)allocating it
+      // only if it doesn't yet exist or doesn't match the requested shape.
+      // The returned fermion is zeroed on allocation, but otherwise holds
+      // whatever it was last used for.
+      if (index >= fermions_.size()) {
+        fermions_.resize(index + 1);
+      }
+
+      auto& ptr = fermions_[index];
+
+      if (not ptr or not matches(*ptr, layout, site_size)) {
+        ptr.reset(new Fermion(layout, ColourVector<Real, Nc>::Zero(),
+                              site_size));
+      }
+
+      return *ptr;
+    }
+
+
+    template <typename Real, int Nc>
+    std::vector<LatticeColourVector<Real, Nc>>& Workspace<Real, Nc>::batch(
+        const unsigned int index, const std::vector<Fermion>& like)
+    {
+      if (index >= batches_.size()) {
+        batches_.resize(index + 1);
+      }
+
+      auto& ptr = batches_[index];
+
+      if (not ptr) {
+        ptr.reset(new std::vector<Fermion>);
+      }
+
+      auto& fermions = *ptr;
+
+      if (fermions.size() > like.size()) {
+        fermions.erase(fermions.begin() + like.size(), fermions.end());
+      }
+
+      for (unsigned int k = 0; k < like.size(); ++k) {
+        const auto& like_fermion = like[k];
+        if (k == fermions.size()) {
+          fermions.emplace_back(like_fermion.layout(),
+                                ColourVector<Real, Nc>::Zero(),
+                                like_fermion.site_size());
+        }
+        else if (not matches(fermions[k], like_fermion.layout(),
+                             like_fermion.site_size())) {
+          fermions[k] = Fermion(like_fermion.layout(),
+                                ColourVector<Real, Nc>::Zero(),
+                                like_fermion.site_size());
+        }
+      }
+
+      return fermions;
+    }
+
+
+    template <typename Real, int Nc>
+    std::vector<LatticeColourVector<Real, Nc>>& Workspace<Real, Nc>::batch(
+        const unsigned int index, const Layout& layout, const Int site_size,
+        const unsigned int size)
+    {
+      if (index >= batches_.size()) {
+        batches_.resize(index + 1);
+      }
+
+      auto& ptr = batches_[index];
+
+      if (not ptr) {
+        ptr.reset(new std::vector<Fermion>);
+      }
+
+      auto& fermions = *ptr;
+
+      if (fermions.size() > size) {
+        fermions.erase(fermions.begin() + size, fermions.end());
+      }
+
+      for (auto& fermion : fermions) {
+        if (not matches(fermion, layout, site_size)) {
+          fermion = Fermion(layout, ColourVector<Real, Nc>::Zero(), site_size);
+        }
+      }
+      while (fermions.size() < size) {
+        fermions.emplace_back(layout, ColourVector<Real, Nc>::Zero(),
+                              site_size);
+      }
+
+      return fermions;
+    }
+  }
+}
+
+#endif //PYQCD_FERMION_WORKSPACE_HPP
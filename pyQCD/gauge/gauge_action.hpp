@@ -24,6 +24,10 @@
  * upon which all gauge actions are based.
  */
 
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
 #include <core/qcd_types.hpp>
 
 
@@ -47,6 +51,18 @@ namespace pyQCD
       virtual GaugeLink compute_staples(const GaugeField& gauge_field,
                                         const Int site_index) const = 0;
 
+      // Compute the staples of the links in direction mu at each of the
+      // specified sites, storing the staple for the link at site x in
+      // staples(x). The staples lattice must have the same layout as the
+      // gauge field and a site size of one. The staples at other sites are
+      // left untouched.
+      virtual void compute_all_staples(const GaugeField& gauge_field,
+                                       GaugeField& staples, const Int mu,
+                                       const std::vector<Int>& sites) const;
+      // As above, but for every site on the lattice
+      void compute_all_staples(const GaugeField& gauge_field,
+                               GaugeField& staples, const Int mu) const;
+
       virtual Real local_action(const GaugeField& gauge_field,
                                 const Int site_index) const = 0;
 
@@ -58,6 +74,10 @@ namespace pyQCD
 
       inline Real beta() const { return beta_; }
 
+    protected:
+      static void check_staples(const GaugeField& gauge_field,
+                                const GaugeField& staples, const Int mu);
+
     private:
       // The inverse coupling
       Real beta_;
@@ -65,6 +85,51 @@ namespace pyQCD
       // simultaneously
       unsigned int min_site_diag_offset_;
     };
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::compute_all_staples(
+        const GaugeField& gauge_field, GaugeField& staples, const Int mu,
+        const std::vector<Int>& sites) const
+    {
+      check_staples(gauge_field, staples, mu);
+
+      const auto& layout = gauge_field.layout();
+      const Int num_dims = gauge_field.site_size();
+      const Int num_sites = sites.size();
+
+#pragma omp parallel for
+      for (Int i = 0; i < num_sites; ++i) {
+        staples[layout.get_array_index(sites[i])] =
+            compute_staples(gauge_field, num_dims * sites[i] + mu);
+      }
+    }
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::compute_all_staples(
+        const GaugeField& gauge_field, GaugeField& staples, const Int mu) const
+    {
+      std::vector<Int> sites(gauge_field.volume());
+      std::iota(sites.begin(), sites.end(), 0);
+      compute_all_staples(gauge_field, staples, mu, sites);
+    }
+
+
+    template <typename Real, int Nc>
+    void Action<Real, Nc>::check_staples(
+        const GaugeField& gauge_field, const GaugeField& staples, const Int mu)
+    {
+      if (staples.volume() != gauge_field.volume() or
+          staples.site_size() != 1) {
+        throw std::invalid_argument(
+            "Staples must be stored on the gauge field layout with one "
+            "matrix per site");
+      }
+      if (mu >= gauge_field.site_size()) {
+        throw std::invalid_argument("Invalid link direction");
+      }
+    }
   }
 }
 
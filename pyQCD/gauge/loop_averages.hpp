@@ -0,0 +1,102 @@
+#ifndef PYQCD_LOOP_AVERAGES_HPP
+#define PYQCD_LOOP_AVERAGES_HPP
+
+/*
+ * This file is part of pyQCD.
+ *
+ * pyQCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * pyQCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ *
+ * Averages of Wilson loops over the lattice, broken down by plane and by
+ * timeslice. The breakdowns are accumulated alongside the overall average in
+ * a single parallel pass over the lattice.
+ */
+
+#include <vector>
+
+#include <core/layout.hpp>
+#include <core/reduction.hpp>
+
+
+namespace pyQCD
+{
+  namespace gauge
+  {
+    template <typename Real>
+    struct LoopAverages
+    {
+      // Average over the whole lattice
+      Real total;
+      // Average in each (mu, nu) plane with mu < nu, ordered (0, 1), (0, 2),
+      // ..., (1, 2), ...
+      std::vector<Real> planes;
+      // Average over the loops with their base site in each timeslice, where
+      // time is the first lattice dimension
+      std::vector<Real> timeslices;
+    };
+
+
+    namespace detail
+    {
+      template <typename Real, typename Fn>
+      LoopAverages<Real> average_loops(const Layout& layout,
+                                       const Int loops_per_plane,
+                                       const Fn& site_loops)
+      {
+        // site_loops(x, plane_sums) should add the loops with base site at
+        // array index x in each plane to plane_sums and return their total.
+        const Int volume = layout.volume();
+        const Int num_dims = layout.num_dims();
+        const Int num_planes = num_dims * (num_dims - 1) / 2;
+        const Int num_timeslices = layout.shape()[0];
+        const Int timeslice_volume = volume / num_timeslices;
+
+        // Partial sums hold the plane sums followed by the timeslice sums
+        const std::vector<Real> zero(num_planes + num_timeslices, 0.0);
+
+        const auto sums = pyQCD::detail::blocked_reduce(
+            volume, zero,
+            [&] (std::vector<Real>& acc, const Int begin, const Int end) {
+              for (Int x = begin; x < end; ++x) {
+                const Int t = layout.get_site_index(x) / timeslice_volume;
+                acc[num_planes + t] += site_loops(x, acc.data());
+              }
+            },
+            [] (std::vector<Real>& acc, const std::vector<Real>& value) {
+              for (unsigned int i = 0; i < acc.size(); ++i) {
+                acc[i] += value[i];
+              }
+            });
+
+        LoopAverages<Real> ret;
+        ret.total = 0.0;
+        ret.planes.resize(num_planes);
+        ret.timeslices.resize(num_timeslices);
+
+        for (Int plane = 0; plane < num_planes; ++plane) {
+          ret.total += sums[plane];
+          ret.planes[plane] = sums[plane] / (loops_per_plane * volume);
+        }
+        ret.total /= loops_per_plane * num_planes * volume;
+        for (Int t = 0; t < num_timeslices; ++t) {
+          ret.timeslices[t] = sums[num_planes + t] /
+              (loops_per_plane * num_planes * timeslice_volume);
+        }
+
+        return ret;
+      }
+    }
+  }
+}
+
+#endif //PYQCD_LOOP_AVERAGES_HPP
@@ -20,11 +20,14 @@
  *
  *
  * Below we define functions to compute a specific plaquette and the average
- * plaquette for a given gauge field.
+ * plaquette for a given gauge field, optionally broken down by plane and
+ * timeslice.
  */
 
 #include <core/qcd_types.hpp>
 
+#include "loop_averages.hpp"
+
 
 namespace pyQCD
 {
@@ -34,37 +37,65 @@ namespace pyQCD
     Real plaquette(const LatticeColourMatrix<Real, Nc>& gauge_field,
                    const Int site, const Int mu, const Int nu)
     {
-      Site site_coords_orig = gauge_field.layout().compute_site_coords(site);
-      Site site_coords_mu = site_coords_orig;
-      Site site_coords_nu = site_coords_orig;
-      site_coords_mu[mu] += 1;
-      site_coords_nu[nu] += 1;
-      gauge_field.layout().sanitize_site_coords(site_coords_mu);
-      gauge_field.layout().sanitize_site_coords(site_coords_nu);
+      const auto& layout = gauge_field.layout();
+      const Int site_size = gauge_field.site_size();
+      const Int arr_index = layout.get_array_index(site);
+      const Int arr_index_mu = layout.neighbour_array_index(arr_index, mu, 1);
+      const Int arr_index_nu = layout.neighbour_array_index(arr_index, nu, 1);
 
-      auto mat = gauge_field(site_coords_orig, mu);
-      mat *= gauge_field(site_coords_mu, nu);
-      mat *= gauge_field(site_coords_nu, mu).adjoint();
-      mat *= gauge_field(site_coords_orig, nu).adjoint();
+      auto mat = gauge_field[site_size * arr_index + mu];
+      mat *= gauge_field[site_size * arr_index_mu + nu];
+      mat *= gauge_field[site_size * arr_index_nu + mu].adjoint();
+      mat *= gauge_field[site_size * arr_index + nu].adjoint();
 
       return mat.trace().real() / Nc;
     }
 
 
+    template <typename Real, int Nc>
+    LoopAverages<Real> plaquette_averages(
+        const LatticeColourMatrix<Real, Nc>& gauge_field)
+    {
+      // Compute the average plaquette, along with the averages in each plane
+      // and timeslice. The trace of U_mu(x) U_nu(x + mu) U^dagger_mu(x + nu)
+      // U^dagger_nu(x) is computed as the element-wise inner product of
+      // U_nu(x) U_mu(x + nu) and U_mu(x) U_nu(x + mu), saving one product.
+      const auto& layout = gauge_field.layout();
+      const Int num_dims = gauge_field.num_dims();
+      const Int site_size = gauge_field.site_size();
+      const Int* neighbours = layout.shift_table(1).data();
+
+      const auto link = [&] (const Int arr_index, const Int dim)
+          -> const ColourMatrix<Real, Nc>&
+      { return gauge_field[site_size * arr_index + dim]; };
+
+      return detail::average_loops<Real>(
+          layout, 1, [&] (const Int x, Real* plane_sums) {
+            Real total = 0.0;
+            Int plane = 0;
+            for (Int mu = 0; mu < num_dims; ++mu) {
+              const Int x_mu = neighbours[2 * (num_dims * x + mu)];
+              for (Int nu = mu + 1; nu < num_dims; ++nu) {
+                const Int x_nu = neighbours[2 * (num_dims * x + nu)];
+                const ColourMatrix<Real, Nc> lower =
+                    link(x, mu) * link(x_mu, nu);
+                const ColourMatrix<Real, Nc> upper =
+                    link(x, nu) * link(x_nu, mu);
+                const Real value =
+                    lower.cwiseProduct(upper.conjugate()).sum().real() / Nc;
+                plane_sums[plane++] += value;
+                total += value;
+              }
+            }
+            return total;
+          });
+    }
+
+
     template <typename Real, int Nc>
     Real average_plaquette(const LatticeColourMatrix<Real, Nc>& gauge_field)
     {
-      Real total = 0.0;
-      Int num = gauge_field.num_dims() * (gauge_field.num_dims() - 1) / 2
-        * gauge_field.volume();
-      for (Int site = 0; site < gauge_field.volume(); ++site) {
-        for (Int mu = 0; mu < gauge_field.num_dims(); ++mu) {
-          for (Int nu = mu + 1; nu < gauge_field.num_dims(); ++nu) {
-            total += plaquette(gauge_field, site, mu, nu);
-          }
-        }
-      }
-      return total / num;
+      return plaquette_averages(gauge_field).total;
     }
   }
 }
@@ -20,11 +20,14 @@
  *
  *
  * Below we define functions to compute a specific rectangle and the average
- * rectangle for a given gauge field.
+ * rectangle for a given gauge field, optionally broken down by plane and
+ * timeslice.
  */
 
 #include <core/qcd_types.hpp>
 
+#include "loop_averages.hpp"
+
 
 namespace pyQCD
 {
@@ -34,47 +37,77 @@ namespace pyQCD
     Real rectangle(const LatticeColourMatrix<Real, Nc>& gauge_field,
                    const Int site, const Int mu, const Int nu)
     {
-      Site site_coords_orig = gauge_field.layout().compute_site_coords(site);
-      Site site_coords_mu = site_coords_orig;
-      Site site_coords_mu_mu = site_coords_orig;
-      Site site_coords_nu_mu = site_coords_orig;
-      Site site_coords_nu = site_coords_orig;
-      site_coords_mu[mu] += 1;
-      site_coords_mu_mu[mu] += 2;
-      site_coords_nu_mu[nu] += 1;
-      site_coords_nu_mu[mu] += 1;
-      site_coords_nu[nu] += 1;
-      gauge_field.layout().sanitize_site_coords(site_coords_mu);
-      gauge_field.layout().sanitize_site_coords(site_coords_mu_mu);
-      gauge_field.layout().sanitize_site_coords(site_coords_nu_mu);
-      gauge_field.layout().sanitize_site_coords(site_coords_nu);
+      const auto& layout = gauge_field.layout();
+      const Int site_size = gauge_field.site_size();
+      const Int arr_index = layout.get_array_index(site);
+      const Int arr_index_mu = layout.neighbour_array_index(arr_index, mu, 1);
+      const Int arr_index_mu_mu =
+          layout.neighbour_array_index(arr_index_mu, mu, 1);
+      const Int arr_index_nu_mu =
+          layout.neighbour_array_index(arr_index_mu, nu, 1);
+      const Int arr_index_nu = layout.neighbour_array_index(arr_index, nu, 1);
 
-      auto mat = gauge_field(site_coords_orig, mu);
-      mat *= gauge_field(site_coords_mu, mu);
-      mat *= gauge_field(site_coords_mu_mu, nu);
-      mat *= gauge_field(site_coords_nu_mu, mu).adjoint();
-      mat *= gauge_field(site_coords_nu, mu).adjoint();
-      mat *= gauge_field(site_coords_orig, nu).adjoint();
+      auto mat = gauge_field[site_size * arr_index + mu];
+      mat *= gauge_field[site_size * arr_index_mu + mu];
+      mat *= gauge_field[site_size * arr_index_mu_mu + nu];
+      mat *= gauge_field[site_size * arr_index_nu_mu + mu].adjoint();
+      mat *= gauge_field[site_size * arr_index_nu + mu].adjoint();
+      mat *= gauge_field[site_size * arr_index + nu].adjoint();
 
       return mat.trace().real() / Nc;
     }
 
 
+    template <typename Real, int Nc>
+    LoopAverages<Real> rectangle_averages(
+        const LatticeColourMatrix<Real, Nc>& gauge_field)
+    {
+      // Compute the average rectangle, along with the averages in each plane
+      // and timeslice. Both orientations of the rectangle are included in
+      // each plane. As for the plaquette, the trace of the loop is computed
+      // as the element-wise inner product of its two halves.
+      const auto& layout = gauge_field.layout();
+      const Int num_dims = gauge_field.num_dims();
+      const Int site_size = gauge_field.site_size();
+      const Int* neighbours = layout.shift_table(1).data();
+
+      const auto fwd = [&] (const Int arr_index, const Int dim)
+      { return neighbours[2 * (num_dims * arr_index + dim)]; };
+      const auto link = [&] (const Int arr_index, const Int dim)
+          -> const ColourMatrix<Real, Nc>&
+      { return gauge_field[site_size * arr_index + dim]; };
+
+      // Rectangle with its long side in direction mu
+      const auto rect = [&] (const Int x, const Int mu, const Int nu) {
+        const Int x_mu = fwd(x, mu);
+        const Int x_nu = fwd(x, nu);
+        ColourMatrix<Real, Nc> lower = link(x, mu) * link(x_mu, mu);
+        lower *= link(fwd(x_mu, mu), nu);
+        ColourMatrix<Real, Nc> upper = link(x, nu) * link(x_nu, mu);
+        upper *= link(fwd(x_nu, mu), mu);
+        return lower.cwiseProduct(upper.conjugate()).sum().real() / Nc;
+      };
+
+      return detail::average_loops<Real>(
+          layout, 2, [&] (const Int x, Real* plane_sums) {
+            Real total = 0.0;
+            Int plane = 0;
+            for (Int mu = 0; mu < num_dims; ++mu) {
+              for (Int nu = mu + 1; nu < num_dims; ++nu) {
+                const Real value = rect(x, mu, nu) + rect(x, nu, mu);
+                plane_sums[plane++] += value;
+                total += value;
+              }
+            }
+            return total;
+          });
+    }
+
+
     template <typename Real, int Nc>
     Real average_rectangle(const LatticeColourMatrix<Real, Nc>& gauge_field)
     {
-      Real total = 0.0;
-      Int num = gauge_field.num_dims() * (gauge_field.num_dims() - 1)
-        * gauge_field.volume();
-      for (Int site = 0; site < gauge_field.volume(); ++site) {
-        for (Int mu = 0; mu < gauge_field.num_dims(); ++mu) {
-          for (Int nu = mu + 1; nu < gauge_field.num_dims(); ++nu) {
-            total += rectangle(gauge_field, site, mu, nu);
-            total += rectangle(gauge_field, site, nu, mu);
-          }
-        }
-      }
-      return total / num;
+      return rectangle_averages(gauge_field).total;
     }
   }
 }
@@ -47,84 +47,26 @@ namespace pyQCD
       std::vector<Int> participating_sites(
           const Int index, const Layout& layout) const override;
 
+      void compute_all_staples(
+          const typename Action<Real, Nc>::GaugeField& gauge_field,
+          typename Action<Real, Nc>::GaugeField& staples, const Int mu,
+          const std::vector<Int>& sites) const override;
+      using Action<Real, Nc>::compute_all_staples;
+
     private:
-      std::vector<std::vector<Int>> links_;
+      // Staples of the link U_mu(x), where x is an array index
+      typename Action<Real, Nc>::GaugeLink compute_link_staples(
+          const typename Action<Real, Nc>::GaugeField& gauge_field,
+          const Int x, const Int mu) const;
     };
 
     template <typename Real, int Nc>
     WilsonAction<Real, Nc>::WilsonAction(const Real beta, const Layout& layout)
       : Action<Real, Nc>(beta, 1)
     {
-      // Determine which link indices belong to which link staples
-      const auto num_dims = layout.num_dims();
-      links_.resize(layout.volume() * num_dims);
-      for (unsigned site_index = 0; site_index < layout.volume(); ++site_index)
-      {
-        const Site link_coords = layout.compute_site_coords(site_index);
-
-        for (Int d = 0; d < num_dims; ++d) { // d = dimension
-          const Int link_index = site_index * num_dims + d;
-          // Determine which plane the link does not contribute to.
-          Site planes(num_dims - 1);
-          unsigned int j = 0;
-          for (unsigned int i = 0; i < num_dims; ++i) {
-            if (d != i) {
-              planes[j++] = i;
-            }
-          }
-
-          links_[link_index].resize(6 * (num_dims - 1));
-
-          for (unsigned int i = 0; i < num_dims - 1; ++i) {
-            std::vector<int> link_coords_copy(
-              link_coords.begin(), link_coords.end());
-            const Int mu = d;
-            const Int nu = planes[i];
-
-            /* First compute the loop above the link. Essentially we're
-             * interested in:
-             *
-             * U_\nu (x + \mu) U^\dagger_\mu (x + \nu) U^\dagger_\nu (x)
-             */
-            // First link in U_\nu (x + \mu)
-            link_coords_copy[mu]++;
-            layout.sanitize_site_coords(link_coords_copy);
-            links_[link_index][6 * i]
-              = layout.get_array_index(link_coords_copy) * num_dims + nu;
-            // Next link is U^\dagger_\mu (x + \nu)
-            link_coords_copy[mu]--;
-            link_coords_copy[nu]++;
-            layout.sanitize_site_coords(link_coords_copy);
-            links_[link_index][6 * i + 1]
-              = layout.get_array_index(link_coords_copy) * num_dims + mu;
-            // Next link is U^\dagger_\nu (x)
-            link_coords_copy[nu]--;
-            layout.sanitize_site_coords(link_coords_copy);
-            links_[link_index][6 * i + 2]
-              = layout.get_array_index(link_coords_copy) * num_dims + nu;
-
-            /* Now we want to compute the staple below the link. Essentially:
-             *
-             * U^\dagger _\nu (x + \mu - \nu) U^\dagger_\mu (x - \nu)
-             *   U^\dagger_\nu (x - \nu)
-             */
-            // First link is U^\dagger_\nu (x + \mu - \nu)
-            link_coords_copy[mu]++;
-            link_coords_copy[nu]--;
-            layout.sanitize_site_coords(link_coords_copy);
-            links_[link_index][6 * i + 3]
-              = layout.get_array_index(link_coords_copy) * num_dims + nu;
-            // Next link is U^\dagger_\mu (x - \nu)
-            link_coords_copy[mu]--;
-            layout.sanitize_site_coords(link_coords_copy);
-            links_[link_index][6 * i + 4]
-              = layout.get_array_index(link_coords_copy) * num_dims + mu;
-            // Next link is U_\nu (x - \nu)
-            links_[link_index][6 * i + 5]
-              = layout.get_array_index(link_coords_copy) * num_dims + nu;
-          }
-        }
-      }
+      // The staples are computed using the unit shift table of the gauge
+      // field's layout, so build it up front rather than in the first update
+      layout.shift_table(1);
     }
 
     template <typename Real, int Nc>
@@ -133,21 +75,75 @@ namespace pyQCD
       const typename Action<Real, Nc>::GaugeField& gauge_field,
       const Int link_index) const
     {
+      // The link is U_mu(x), with link_index = num_dims * x + mu for site
+      // index x
+      const Int num_dims = gauge_field.site_size();
+      return compute_link_staples(
+          gauge_field,
+          gauge_field.layout().get_array_index(link_index / num_dims),
+          link_index % num_dims);
+    }
+
+
+    template <typename Real, int Nc>
+    void WilsonAction<Real, Nc>::compute_all_staples(
+        const typename Action<Real, Nc>::GaugeField& gauge_field,
+        typename Action<Real, Nc>::GaugeField& staples, const Int mu,
+        const std::vector<Int>& sites) const
+    {
+      // Overridden so that the loop avoids a virtual call per link
+      this->check_staples(gauge_field, staples, mu);
+
+      const auto& layout = gauge_field.layout();
+      const Int num_sites = sites.size();
+
+#pragma omp parallel for
+      for (Int i = 0; i < num_sites; ++i) {
+        const Int x = layout.get_array_index(sites[i]);
+        staples[x] = compute_link_staples(gauge_field, x, mu);
+      }
+    }
+
+
+    template <typename Real, int Nc>
+    typename Action<Real, Nc>::GaugeLink
+    WilsonAction<Real, Nc>::compute_link_staples(
+        const typename Action<Real, Nc>::GaugeField& gauge_field,
+        const Int x, const Int mu) const
+    {
+      // Neighbours are found using the layout's shift table.
       auto ret = Action<Real, Nc>::GaugeLink::Zero().eval();
       auto temp_colour_mat = ret;
 
-      const auto num_dims = gauge_field.layout().num_dims();
+      const auto& layout = gauge_field.layout();
+      const Int num_dims = layout.num_dims();
+      const auto& neighbours = layout.shift_table(1);
+
+      const Int x_mu = neighbours[2 * (num_dims * x + mu)];
+
+      const auto link = [&] (const Int arr_index, const Int dim)
+          -> const typename Action<Real, Nc>::GaugeLink&
+      { return gauge_field[num_dims * arr_index + dim]; };
+
+      for (Int nu = 0; nu < num_dims; ++nu) {
+        if (nu == mu) {
+          continue;
+        }
+        const Int x_nu = neighbours[2 * (num_dims * x + nu)];
+        const Int x_mnu = neighbours[2 * (num_dims * x + nu) + 1];
+        const Int x_mu_mnu = neighbours[2 * (num_dims * x_mu + nu) + 1];
 
-      for (unsigned int i = 0; i < 6 * (num_dims - 1); i += 6) {
-        temp_colour_mat = gauge_field[links_[link_index][i]];
-        temp_colour_mat *= gauge_field[links_[link_index][i + 1]].adjoint();
-        temp_colour_mat *= gauge_field[links_[link_index][i + 2]].adjoint();
+        // U_nu(x + mu) U^dagger_mu(x + nu) U^dagger_nu(x)
+        temp_colour_mat = link(x_mu, nu);
+        temp_colour_mat *= link(x_nu, mu).adjoint();
+        temp_colour_mat *= link(x, nu).adjoint();
 
         ret += temp_colour_mat;
 
-        temp_colour_mat = gauge_field[links_[link_index][i + 3]].adjoint();
-        temp_colour_mat *= gauge_field[links_[link_index][i + 4]].adjoint();
-        temp_colour_mat *= gauge_field[links_[link_index][i + 5]];
+        // U^dagger_nu(x + mu - nu) U^dagger_mu(x - nu) U_nu(x - nu)
+        temp_colour_mat = link(x_mu_mnu, nu).adjoint();
+        temp_colour_mat *= link(x_mnu, mu).adjoint();
+        temp_colour_mat *= link(x_mnu, nu);
 
         ret += temp_colour_mat;
       }
@@ -178,25 +174,20 @@ namespace pyQCD
       std::vector<Int> ret;
       ret.reserve(num_planes * 4);
 
-      const auto coords = layout.compute_site_coords(index);
-      std::vector<int> working_coords(coords.begin(), coords.end());
+      Int working_index = layout.get_array_index(index);
 
       for (unsigned int mu = 1; mu < layout.num_dims(); ++mu) {
         for (unsigned int nu = 0; nu < mu; ++nu) {
-          working_coords[mu] += 1;
-          layout.sanitize_site_coords(working_coords);
-          ret.push_back(layout.get_array_index(working_coords));
-          working_coords[mu] -= 2;
-          layout.sanitize_site_coords(working_coords);
-          ret.push_back(layout.get_array_index(working_coords));
-          working_coords[mu] += 1;
-          working_coords[nu] += 1;
-          layout.sanitize_site_coords(working_coords);
-          ret.push_back(layout.get_array_index(working_coords));
-          working_coords[nu] -= 2;
-          layout.sanitize_site_coords(working_coords);
-          ret.push_back(layout.get_array_index(working_coords));
-          working_coords[nu] += 1;
+          working_index = layout.neighbour_array_index(working_index, mu, 1);
+          ret.push_back(working_index);
+          working_index = layout.neighbour_array_index(working_index, mu, -2);
+          ret.push_back(working_index);
+          working_index = layout.neighbour_array_index(working_index, mu, 1);
+          working_index = layout.neighbour_array_index(working_index, nu, 1);
+          ret.push_back(working_index);
+          working_index = layout.neighbour_array_index(working_index, nu, -2);
+          ret.push_back(working_index);
+          working_index = layout.neighbour_array_index(working_index, nu, 1);
         }
       }
 
@@ -167,3 +167,187 @@ TEST_CASE("Testing even-odd preconditioned conjugate gradient algorithm")
     }
   }
 }
+
+
+
+TEST_CASE("Testing mixed-precision conjugate gradient algorithms")
+{
+  using SiteFermion = pyQCD::ColourVector<double, 3>;
+  using LatticeFermion = pyQCD::LatticeColourVector<double, 3>;
+  using GaugeField = pyQCD::LatticeColourMatrix<double, 3>;
+
+  const pyQCD::EvenOddLayout layout({8, 4, 4, 4});
+
+  pyQCD::RandGenerator rng;
+  GaugeField gauge_field(layout, 4);
+  for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+    gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+  }
+
+  LatticeFermion src(layout, SiteFermion::Zero(), 4);
+  src[0][0] = 1.0;
+
+  const std::vector<double> boundary_rotations{0.5, 0.0, 0.0, 0.0};
+
+  const pyQCD::fermions::WilsonAction<double, 3> action(
+      0.4, gauge_field, boundary_rotations);
+  const pyQCD::fermions::WilsonAction<float, 3> inner_action(action);
+
+  const MatrixCompare<SiteFermion> compare(1e-10, 1e-10);
+
+  SECTION ("Testing precision conversion")
+  {
+    const auto src_float = pyQCD::convert_precision<float>(src);
+    const auto src_double = pyQCD::convert_precision<double>(src_float);
+
+    for (unsigned int i = 0; i < src.size(); ++i) {
+      REQUIRE (compare(src_double[i], src[i]));
+    }
+  }
+
+  SECTION ("Testing unpreconditioned solver")
+  {
+    const auto result = pyQCD::conjugate_gradient_mixed_unprec(
+        action, inner_action, src, 1000, 1e-10);
+
+    REQUIRE ((result.tolerance() < 1e-10 and result.tolerance() > 0));
+
+    LatticeFermion lhs(layout, 4);
+    lhs = action.apply_full(result.solution());
+
+    for (unsigned int i = 0; i < lhs.size(); ++i) {
+      REQUIRE (compare(lhs[i], src[i]));
+    }
+  }
+
+  SECTION ("Testing even-odd preconditioned solver")
+  {
+    const auto result = pyQCD::conjugate_gradient_mixed_eoprec(
+        action, inner_action, src, 1000, 1e-10);
+
+    REQUIRE ((result.tolerance() < 1e-10 and result.tolerance() > 0));
+
+    LatticeFermion lhs(layout, 4);
+    lhs = action.apply_full(result.solution());
+
+    for (unsigned int i = 0; i < lhs.size(); ++i) {
+      REQUIRE (compare(lhs[i], src[i]));
+    }
+  }
+}
+
+TEST_CASE("Testing multi-shift conjugate gradient algorithm")
+{
+  using SiteFermion = pyQCD::ColourVector<double, 3>;
+  using LatticeFermion = pyQCD::LatticeColourVector<double, 3>;
+  using GaugeField = pyQCD::LatticeColourMatrix<double, 3>;
+
+  const pyQCD::LexicoLayout layout({8, 4, 4, 4});
+
+  pyQCD::RandGenerator rng;
+  GaugeField gauge_field(layout, 4);
+  for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+    gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+  }
+
+  LatticeFermion src(layout, SiteFermion::Zero(), 4);
+  src[0][0] = 1.0;
+
+  const std::vector<double> boundary_rotations{0.5, 0.0, 0.0, 0.0};
+  const pyQCD::fermions::WilsonAction<double, 3> action(
+      0.4, gauge_field, boundary_rotations);
+
+  const std::vector<double> shifts{0.5, 0.0, 0.1};
+
+  const auto results = pyQCD::conjugate_gradient_multishift(
+      action, src, shifts, 1000, 1e-10);
+
+  REQUIRE (results.size() == shifts.size());
+  REQUIRE (results[0].num_iterations() < results[2].num_iterations());
+  REQUIRE (results[2].num_iterations() <= results[1].num_iterations());
+
+  const MatrixCompare<SiteFermion> compare(1e-8, 1e-9);
+
+  for (unsigned int k = 0; k < shifts.size(); ++k) {
+    REQUIRE ((results[k].tolerance() < 1e-10 and results[k].tolerance() > 0));
+
+    const auto& solution = results[k].solution();
+    auto lhs = action.apply_hermiticity(action.apply_full(solution));
+    lhs = action.apply_hermiticity(action.apply_full(lhs));
+    lhs += shifts[k] * solution;
+
+    for (unsigned int i = 0; i < lhs.size(); ++i) {
+      REQUIRE (compare(lhs[i], src[i]));
+    }
+  }
+}
+
+
+TEST_CASE("Testing block conjugate gradient algorithms")
+{
+  using SiteFermion = pyQCD::ColourVector<double, 3>;
+  using LatticeFermion = pyQCD::LatticeColourVector<double, 3>;
+  using GaugeField = pyQCD::LatticeColourMatrix<double, 3>;
+
+  const pyQCD::EvenOddLayout layout({8, 4, 4, 4});
+
+  pyQCD::RandGenerator rng;
+  GaugeField gauge_field(layout, 4);
+  for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+    gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+  }
+
+  // Point sources for each spin-colour component on the origin
+  std::vector<LatticeFermion> sources;
+  for (unsigned int alpha = 0; alpha < 4; ++alpha) {
+    for (unsigned int a = 0; a < 3; ++a) {
+      sources.emplace_back(layout, SiteFermion::Zero(), 4);
+      sources.back()[alpha][a] = 1.0;
+    }
+  }
+
+  const std::vector<double> boundary_rotations{0.5, 0.0, 0.0, 0.0};
+
+  const pyQCD::fermions::WilsonAction<double, 3> action(
+      0.4, gauge_field, boundary_rotations);
+
+  const MatrixCompare<SiteFermion> compare(1e-8, 1e-9);
+
+  const auto check_solutions =
+      [&] (const pyQCD::BlockSolutionWrapper<double, 3>& result,
+           const pyQCD::Int max_single_iterations)
+      {
+        REQUIRE (result.num_solutions() == sources.size());
+        REQUIRE (result.num_iterations() <= max_single_iterations);
+
+        for (unsigned int k = 0; k < sources.size(); ++k) {
+          REQUIRE ((result.tolerance(k) < 1e-10 and result.tolerance(k) > 0));
+          REQUIRE (result.num_iterations(k) <= result.num_iterations());
+
+          const auto lhs = action.apply_full(result.solution(k));
+          for (unsigned int i = 0; i < lhs.size(); ++i) {
+            REQUIRE (compare(lhs[i], sources[k][i]));
+          }
+        }
+      };
+
+  SECTION ("Testing unpreconditioned block solver")
+  {
+    const auto single_result = pyQCD::conjugate_gradient_unprec(
+        action, sources.front(), 1000, 1e-10);
+    const auto result = pyQCD::conjugate_gradient_block_unprec(
+        action, sources, 1000, 1e-10);
+
+    check_solutions(result, single_result.num_iterations());
+  }
+
+  SECTION ("Testing even-odd preconditioned block solver")
+  {
+    const auto single_result = pyQCD::conjugate_gradient_eoprec(
+        action, sources.front(), 1000, 1e-10);
+    const auto result = pyQCD::conjugate_gradient_block_eoprec(
+        action, sources, 1000, 1e-10);
+
+    check_solutions(result, single_result.num_iterations());
+  }
+}
@@ -123,6 +123,32 @@ TEST_CASE("Heatbath test")
     }
   }
 
+  SECTION ("Testing SU(3) overrelaxation update") {
+
+    using ColourMatrix = pyQCD::ColourMatrix<Real, 3>;
+
+    Compare<Real> comp(1.0e-10, 1.0e-10);
+    MatrixCompare<ColourMatrix> mat_comp(1.0e-10, 1.0e-10);
+
+    ColourMatrix link = pyQCD::random_sun<Real, 3>(rng);
+    ColourMatrix staple = ColourMatrix::Zero();
+    for (unsigned int i = 0; i < 6; ++i) {
+      staple += pyQCD::random_sun<Real, 3>(rng);
+    }
+    const ColourMatrix old_link = link;
+
+    pyQCD::overrelaxation_link_update(link, staple);
+
+    // The action is unchanged, but the link isn't
+    REQUIRE(comp((link * staple).trace().real(),
+                 (old_link * staple).trace().real()));
+    REQUIRE(not mat_comp(link, old_link));
+    auto det = link.determinant();
+    REQUIRE(comp(det.real(), 1.0));
+    REQUIRE(comp(det.imag(), 0.0));
+    REQUIRE(mat_comp(link.adjoint() * link, ColourMatrix::Identity()));
+  }
+
   SECTION ("Testing SU(3) heatbath update") {
 
     using ColourMatrix = pyQCD::ColourMatrix<Real, 3>;
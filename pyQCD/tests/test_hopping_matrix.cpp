@@ -20,6 +20,7 @@
  */
 
 #include <fermions/hopping_matrix.hpp>
+#include <fermions/simd_hopping_matrix.hpp>
 #include <utils/matrices.hpp>
 #include <utils/random.hpp>
 
@@ -79,6 +80,15 @@ TEST_CASE ("Testing hopping matrix")
     auto fermion_out = hopping_matrix.apply_full(fermion_in);
 
     REQUIRE(comp(fermion_out[0], even_fermion_result));
+
+    // Mismatched fermions would be indexed out of bounds
+    LatticeFermion small_fermion(lexico_layout, 2);
+    REQUIRE_THROWS_AS(hopping_matrix.apply_full(fermion_in, small_fermion),
+                      const std::invalid_argument&);
+    REQUIRE_THROWS_AS(hopping_matrix.apply_even_odd(small_fermion, fermion_out),
+                      const std::invalid_argument&);
+    REQUIRE_THROWS_AS(hopping_matrix.apply_odd_even(fermion_in, small_fermion),
+                      const std::invalid_argument&);
   }
 
   SECTION ("Testing non-trivial BCs")
@@ -120,4 +130,290 @@ TEST_CASE ("Testing hopping matrix")
 
     REQUIRE(comp(fermion_out[1024], odd_fermion_result));
   }
+
+  SECTION ("Testing spin-projected Wilson hopping")
+  {
+    const auto gammas = pyQCD::generate_gamma_matrices<double>(4);
+    std::vector<Eigen::MatrixXcd> wilson_structures(8, identity);
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      wilson_structures[2 * mu] = -0.5 * (identity - gammas[mu]);
+      wilson_structures[2 * mu + 1] = -0.5 * (identity + gammas[mu]);
+    }
+
+    const MatrixCompare<Eigen::MatrixXcd> spin_comp(1e-10, 1e-12);
+    for (const auto& spin_structure : wilson_structures) {
+      const auto projection =
+          pyQCD::fermions::factorise_spin_structure(spin_structure);
+      REQUIRE(projection.projector.rows() == 2);
+      REQUIRE(spin_comp(projection.reconstructor * projection.projector,
+                        spin_structure));
+    }
+
+    for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+      gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+    }
+    for (unsigned int i = 0; i < fermion_in.size(); ++i) {
+      fermion_in[i] = SiteFermion::Random();
+    }
+
+    std::vector<std::complex<double>> boundary_phases(4, 1.0);
+
+    const auto hopping_matrix =
+        pyQCD::fermions::HoppingMatrix<double, 3, 1>(
+            gauge_field, boundary_phases, wilson_structures);
+
+    const auto fermion_out = hopping_matrix.apply_full(fermion_in);
+    REQUIRE(hopping_matrix.spin_kernel() ==
+            pyQCD::fermions::SpinKernel::Wilson);
+
+    // Rescaled Wilson structures must fall back to the generic kernel
+    std::vector<Eigen::MatrixXcd> scaled_structures(wilson_structures);
+    for (auto& spin_structure : scaled_structures) {
+      spin_structure *= 2.0;
+    }
+    const auto table_hopping_matrix =
+        pyQCD::fermions::HoppingMatrix<double, 3, 1>(
+            gauge_field, boundary_phases, scaled_structures);
+    REQUIRE(table_hopping_matrix.spin_kernel() ==
+            pyQCD::fermions::SpinKernel::Table);
+
+    const auto table_fermion_out = table_hopping_matrix.apply_full(fermion_in);
+    for (unsigned int i = 0; i < fermion_out.size(); ++i) {
+      REQUIRE(comp(table_fermion_out[i], 2.0 * fermion_out[i]));
+    }
+
+    for (const auto site_index : {0u, 100u, 511u}) {
+      const auto coords = lexico_layout.compute_site_coords(site_index);
+
+      for (unsigned int alpha = 0; alpha < 4; ++alpha) {
+        SiteFermion expected = SiteFermion::Zero();
+
+        for (unsigned int mu = 0; mu < 4; ++mu) {
+          auto coords_plus = coords;
+          auto coords_minus = coords;
+          coords_plus[mu] += 1;
+          coords_minus[mu] += lexico_layout.shape()[mu] - 1;
+          lexico_layout.sanitize_site_coords(coords_plus);
+          lexico_layout.sanitize_site_coords(coords_minus);
+
+          for (unsigned int beta = 0; beta < 4; ++beta) {
+            expected += wilson_structures[2 * mu](alpha, beta) *
+                gauge_field(coords, mu) * fermion_in(coords_plus, beta);
+            expected += wilson_structures[2 * mu + 1](alpha, beta) *
+                gauge_field(coords_minus, mu).adjoint() *
+                fermion_in(coords_minus, beta);
+          }
+        }
+
+        REQUIRE(comp(fermion_out(site_index, alpha), expected));
+      }
+    }
+  }
+
+  SECTION ("Testing compressed links")
+  {
+    const auto gammas = pyQCD::generate_gamma_matrices<double>(4);
+    std::vector<Eigen::MatrixXcd> wilson_structures(8, identity);
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      wilson_structures[2 * mu] = -0.5 * (identity - gammas[mu]);
+      wilson_structures[2 * mu + 1] = -0.5 * (identity + gammas[mu]);
+    }
+
+    for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+      gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+    }
+    for (unsigned int i = 0; i < fermion_in.size(); ++i) {
+      fermion_in[i] = SiteFermion::Random();
+    }
+
+    const std::vector<std::complex<double>> boundary_phases{
+        -1.0, pyQCD::I, 1.0, std::exp(0.3 * pyQCD::I)};
+
+    using pyQCD::fermions::LinkCompression;
+    using HoppingMatrix = pyQCD::fermions::HoppingMatrix<double, 3, 1>;
+
+    const HoppingMatrix reference(gauge_field, boundary_phases,
+                                  wilson_structures);
+    const auto expected_full = reference.apply_full(fermion_in);
+    const auto expected_even_odd = reference.apply_even_odd(fermion_in);
+    const auto expected_odd_even = reference.apply_odd_even(fermion_in);
+
+    for (const auto compression :
+        {LinkCompression::TwelveReal, LinkCompression::EightReal}) {
+      const HoppingMatrix hopping_matrix(gauge_field, boundary_phases,
+                                         wilson_structures, compression);
+
+      const auto result_full = hopping_matrix.apply_full(fermion_in);
+      const auto result_even_odd = hopping_matrix.apply_even_odd(fermion_in);
+      const auto result_odd_even = hopping_matrix.apply_odd_even(fermion_in);
+
+      for (unsigned int i = 0; i < fermion_in.size(); ++i) {
+        REQUIRE(comp(result_full[i], expected_full[i]));
+        REQUIRE(comp(result_even_odd[i], expected_even_odd[i]));
+        REQUIRE(comp(result_odd_even[i], expected_odd_even[i]));
+      }
+    }
+
+    // The eight real representation is singular for the unit gauge field,
+    // so twelve reals should be used instead
+    const pyQCD::LatticeColourMatrix<double, 3> unit_field(
+        lexico_layout, pyQCD::ColourMatrix<double, 3>::Identity(), 4);
+    const HoppingMatrix unit_reference(unit_field, boundary_phases,
+                                       wilson_structures);
+    const HoppingMatrix unit_hopping_matrix(unit_field, boundary_phases,
+                                            wilson_structures,
+                                            LinkCompression::EightReal);
+    REQUIRE(unit_hopping_matrix.compression() == LinkCompression::TwelveReal);
+
+    const auto unit_expected = unit_reference.apply_full(fermion_in);
+    const auto unit_result = unit_hopping_matrix.apply_full(fermion_in);
+    for (unsigned int i = 0; i < fermion_in.size(); ++i) {
+      REQUIRE(comp(unit_result[i], unit_expected[i]));
+    }
+
+    using HoppingMatrix2 = pyQCD::fermions::HoppingMatrix<double, 2, 1>;
+    const pyQCD::LatticeColourMatrix<double, 2> su2_field(
+        lexico_layout, pyQCD::ColourMatrix<double, 2>::Identity(), 4);
+    REQUIRE_THROWS_AS(
+        HoppingMatrix2(su2_field, boundary_phases, wilson_structures,
+                       LinkCompression::TwelveReal),
+        const std::invalid_argument&);
+  }
+
+  SECTION ("Testing batched application")
+  {
+    const auto gammas = pyQCD::generate_gamma_matrices<double>(4);
+    std::vector<Eigen::MatrixXcd> wilson_structures(8, identity);
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      wilson_structures[2 * mu] = -0.5 * (identity - gammas[mu]);
+      wilson_structures[2 * mu + 1] = -0.5 * (identity + gammas[mu]);
+    }
+
+    for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+      gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+    }
+
+    const std::vector<std::complex<double>> boundary_phases{
+        -1.0, 1.0, 1.0, 1.0};
+
+    using pyQCD::fermions::LinkCompression;
+    using HoppingMatrix = pyQCD::fermions::HoppingMatrix<double, 3, 1>;
+
+    std::vector<LatticeFermion> fermions_in(
+        3, LatticeFermion(lexico_layout, 4));
+    for (auto& fermion : fermions_in) {
+      for (unsigned int i = 0; i < fermion.size(); ++i) {
+        fermion[i] = SiteFermion::Random();
+      }
+    }
+
+    for (const auto compression :
+        {LinkCompression::None, LinkCompression::TwelveReal}) {
+      const HoppingMatrix hopping_matrix(gauge_field, boundary_phases,
+                                         wilson_structures, compression);
+
+      const auto results_full = hopping_matrix.apply_full(fermions_in);
+      std::vector<LatticeFermion> results_even_odd(
+          3, LatticeFermion(lexico_layout, SiteFermion::Zero(), 4));
+      hopping_matrix.apply_even_odd(fermions_in, results_even_odd);
+
+      REQUIRE (results_full.size() == fermions_in.size());
+
+      for (unsigned int k = 0; k < fermions_in.size(); ++k) {
+        const auto expected_full = hopping_matrix.apply_full(fermions_in[k]);
+        const auto expected_even_odd =
+            hopping_matrix.apply_even_odd(fermions_in[k]);
+
+        for (unsigned int i = 0; i < fermions_in[k].size(); ++i) {
+          REQUIRE(comp(results_full[k][i], expected_full[i]));
+          REQUIRE(comp(results_even_odd[k][i], expected_even_odd[i]));
+        }
+      }
+    }
+
+    const HoppingMatrix hopping_matrix(gauge_field, boundary_phases,
+                                       wilson_structures);
+    std::vector<LatticeFermion> results(2, LatticeFermion(lexico_layout, 4));
+    REQUIRE_THROWS_AS(hopping_matrix.apply_full(fermions_in, results),
+                      const std::invalid_argument&);
+  }
+}
+
+
+TEST_CASE ("Testing SIMD hopping matrix")
+{
+  using SiteFermion = pyQCD::ColourVector<double, 3>;
+  using LatticeFermion = pyQCD::LatticeColourVector<double, 3>;
+  using GaugeField = pyQCD::LatticeColourMatrix<double, 3>;
+
+  pyQCD::RandGenerator rng;
+
+  const pyQCD::LexicoLayout lexico_layout({8, 4, 4, 4});
+  const pyQCD::VirtualNodeLayout simd_layout({8, 4, 4, 4}, {2, 1, 1, 2});
+
+  GaugeField gauge_field(lexico_layout, 4);
+  for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+    gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+  }
+  LatticeFermion fermion_in(lexico_layout, 4);
+  for (unsigned int i = 0; i < fermion_in.size(); ++i) {
+    fermion_in[i] = SiteFermion::Random();
+  }
+
+  const auto identity = Eigen::Matrix4cd::Identity();
+  const auto gammas = pyQCD::generate_gamma_matrices<double>(4);
+  std::vector<Eigen::MatrixXcd> wilson_structures(8, identity);
+  for (unsigned int mu = 0; mu < 4; ++mu) {
+    wilson_structures[2 * mu] = -0.5 * (identity - gammas[mu]);
+    wilson_structures[2 * mu + 1] = -0.5 * (identity + gammas[mu]);
+  }
+
+  const std::vector<std::complex<double>> boundary_phases{
+      -1.0, pyQCD::I, 1.0, std::exp(0.3 * pyQCD::I)};
+
+  const MatrixCompare<SiteFermion> comp(1e-10, 1e-12);
+
+  const auto simd_fermion_in =
+      pyQCD::pack_simd<double, 3, 4>(fermion_in, simd_layout);
+
+  SECTION ("Testing packing") {
+    LatticeFermion fermion_out(lexico_layout, SiteFermion::Zero(), 4);
+    pyQCD::unpack_simd(simd_fermion_in, simd_layout, fermion_out);
+
+    for (unsigned int i = 0; i < fermion_in.size(); ++i) {
+      REQUIRE(comp(fermion_out[i], fermion_in[i]));
+    }
+  }
+
+  SECTION ("Testing arithmetic") {
+    pyQCD::LatticeSimdColourVector<double, 3, 4> simd_fermion_out(
+        simd_layout.outer_layout(), 4);
+    simd_fermion_out = 2.0 * simd_fermion_in - simd_fermion_in * pyQCD::I;
+    simd_fermion_out += simd_fermion_in;
+
+    LatticeFermion fermion_out(lexico_layout, SiteFermion::Zero(), 4);
+    pyQCD::unpack_simd(simd_fermion_out, simd_layout, fermion_out);
+
+    for (unsigned int i = 0; i < fermion_in.size(); ++i) {
+      const SiteFermion expected = (3.0 - pyQCD::I) * fermion_in[i];
+      REQUIRE(comp(fermion_out[i], expected));
+    }
+  }
+
+  SECTION ("Testing hopping") {
+    const pyQCD::fermions::HoppingMatrix<double, 3, 1> reference(
+        gauge_field, boundary_phases, wilson_structures);
+    const pyQCD::fermions::SimdHoppingMatrix<double, 3, 4> hopping_matrix(
+        gauge_field, boundary_phases, wilson_structures, simd_layout);
+
+    const auto expected = reference.apply_full(fermion_in);
+    const auto simd_fermion_out = hopping_matrix.apply_full(simd_fermion_in);
+
+    LatticeFermion fermion_out(lexico_layout, SiteFermion::Zero(), 4);
+    pyQCD::unpack_simd(simd_fermion_out, simd_layout, fermion_out);
+
+    for (unsigned int i = 0; i < fermion_in.size(); ++i) {
+      REQUIRE(comp(fermion_out[i], expected[i]));
+    }
+  }
 }
\ No newline at end of file
@@ -20,9 +20,17 @@
  * Tests for the Lattice template class.
  */
 
+#include <cstdint>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <Eigen/Dense>
 
 #include <core/lattice.hpp>
+#include <core/lattice_shift.hpp>
+#include <core/reduction.hpp>
 
 #include "helpers.hpp"
 
@@ -109,6 +117,16 @@ TEST_CASE("Lattice test") {
     REQUIRE(lattice1.num_dims() == 4);
   }
 
+  SECTION("Test data alignment") {
+    REQUIRE((reinterpret_cast<std::uintptr_t>(&lattice1[0]) % 64 == 0));
+    REQUIRE((reinterpret_cast<std::uintptr_t>(&lattice_matrix[0]) % 64 == 0));
+
+    const pyQCD::LexicoLayout large_layout({16, 16, 16, 16});
+    pyQCD::Lattice<Eigen::Matrix3cd> large_lattice(large_layout);
+    REQUIRE((reinterpret_cast<std::uintptr_t>(&large_lattice[0]) %
+             pyQCD::detail::huge_page_size == 0));
+  }
+
   SECTION("Test non-scalar site types") {
     const MatrixCompare<Eigen::Matrix3cd> comparison(1e-5, 1e-8);
     pyQCD::Lattice<Eigen::Matrix3cd> result(lattice_matrix.layout());
@@ -177,3 +195,177 @@ TEST_CASE("Non-fundamental Lattice types test") {
   pyQCD::Lattice<Eigen::Vector3cd> vecs(lattice_matrix.layout());
   vecs = lattice_matrix * vec * lattice_double;
 }
+
+
+TEST_CASE("Lattice reductions test") {
+  const pyQCD::LexicoLayout layout({8, 8, 8, 8});
+
+  pyQCD::Lattice<Eigen::Vector3cd> psi(layout, 4);
+  pyQCD::Lattice<Eigen::Vector3cd> eta(layout, 4);
+  for (unsigned int i = 0; i < psi.size(); ++i) {
+    psi[i] = Eigen::Vector3cd::Random();
+    eta[i] = Eigen::Vector3cd::Random();
+  }
+
+  std::complex<double> expected_dot = 0.0;
+  double expected_norm = 0.0;
+  Eigen::Vector3cd expected_sum = Eigen::Vector3cd::Zero();
+  for (unsigned int i = 0; i < psi.size(); ++i) {
+    expected_dot += psi[i].dot(eta[i]);
+    expected_norm += psi[i].squaredNorm();
+    expected_sum += psi[i] + eta[i];
+  }
+
+  SECTION("Testing results") {
+    const auto dot = pyQCD::inner_product(psi, eta);
+    REQUIRE(dot.real() == Approx(expected_dot.real()));
+    REQUIRE(dot.imag() == Approx(expected_dot.imag()));
+    REQUIRE(pyQCD::real_inner_product(psi, eta) ==
+            Approx(expected_dot.real()));
+    REQUIRE(pyQCD::norm2(psi) == Approx(expected_norm));
+
+    const Eigen::Vector3cd result_sum = pyQCD::sum(psi + eta);
+    REQUIRE(result_sum.isApprox(expected_sum));
+
+    const auto half_size = layout.volume() / 2;
+    const auto view_norm = pyQCD::norm2(psi.segment(0, half_size)) +
+                           pyQCD::norm2(psi.segment(half_size, half_size));
+    REQUIRE(view_norm == Approx(expected_norm));
+
+    double expected_diff_norm = 0.0;
+    double expected_max_abs = 0.0;
+    for (unsigned int i = 0; i < psi.size(); ++i) {
+      expected_diff_norm += (psi[i] - 2.0 * eta[i]).squaredNorm();
+      expected_max_abs =
+          std::max(expected_max_abs, psi[i].cwiseAbs().maxCoeff());
+    }
+    REQUIRE(pyQCD::norm2(psi - 2.0 * eta) == Approx(expected_diff_norm));
+    REQUIRE(pyQCD::max_abs(psi) == expected_max_abs);
+
+    const auto expr_dot = pyQCD::inner(psi + eta, psi - eta);
+    const auto expected_expr_dot = pyQCD::inner(psi, psi) -
+        pyQCD::inner(eta, eta) - pyQCD::inner(psi, eta) +
+        pyQCD::inner(eta, psi);
+    REQUIRE(expr_dot.real() == Approx(expected_expr_dot.real()));
+    REQUIRE(expr_dot.imag() == Approx(expected_expr_dot.imag()));
+
+    const pyQCD::Lattice<double> scalars(layout, 0.5);
+    REQUIRE(pyQCD::sum(scalars * 2.0) == Approx(layout.volume()));
+    REQUIRE(pyQCD::norm2(scalars) == Approx(0.25 * layout.volume()));
+    REQUIRE(pyQCD::max_abs(scalars - 1.5) == 1.0);
+  }
+
+#ifdef _OPENMP
+  SECTION("Testing reproducibility across thread counts") {
+    const int num_threads = omp_get_max_threads();
+
+    omp_set_num_threads(1);
+    const auto dot_serial = pyQCD::inner_product(psi, eta);
+    const auto norm_serial = pyQCD::norm2(psi - eta);
+
+    omp_set_num_threads(4);
+    const auto dot_parallel = pyQCD::inner_product(psi, eta);
+    const auto norm_parallel = pyQCD::norm2(psi - eta);
+
+    omp_set_num_threads(num_threads);
+
+    REQUIRE(dot_serial == dot_parallel);
+    REQUIRE(norm_serial == norm_parallel);
+  }
+#endif
+}
+
+
+TEST_CASE("Lattice shift test") {
+  using ColourVector = Eigen::Vector3cd;
+  using ColourMatrix = Eigen::Matrix3cd;
+
+  const pyQCD::EvenOddLayout layout({8, 4, 4, 4});
+
+  pyQCD::Lattice<ColourVector> psi(layout, 2);
+  pyQCD::Lattice<ColourMatrix> links(layout, 2);
+  for (unsigned int i = 0; i < psi.size(); ++i) {
+    psi[i] = ColourVector::Random();
+    links[i] = ColourMatrix::Random();
+  }
+
+  SECTION("Testing shifted elements") {
+    for (int disp : {1, -1, 3, -2}) {
+      pyQCD::Lattice<ColourVector> shifted(layout, 2);
+      shifted = pyQCD::shift(psi, 1, disp);
+
+      bool elements_match = true;
+      for (pyQCD::Int site = 0; site < layout.volume(); ++site) {
+        const auto neighbour = layout.shift_site_index(site, 1, disp);
+        for (pyQCD::Int s = 0; s < 2; ++s) {
+          elements_match = elements_match and
+              shifted(site, s) == psi(neighbour, s);
+        }
+      }
+      REQUIRE(elements_match);
+    }
+
+    pyQCD::Lattice<ColourVector> unshifted(layout, 2);
+    unshifted = pyQCD::shift(psi, 2, 0);
+    REQUIRE(pyQCD::max_abs(unshifted - psi) == 0.0);
+  }
+
+  SECTION("Testing fused stencils") {
+    // Compute U(x) psi(x + e_0) + psi(x - e_1)
+    pyQCD::Lattice<ColourVector> result(layout, 2);
+    result = links * pyQCD::shift(psi, 0, 1) + pyQCD::shift(psi, 1, -1);
+
+    bool elements_match = true;
+    for (pyQCD::Int site = 0; site < layout.volume(); ++site) {
+      const auto fwd = layout.shift_site_index(site, 0, 1);
+      const auto bck = layout.shift_site_index(site, 1, -1);
+      for (pyQCD::Int s = 0; s < 2; ++s) {
+        const ColourVector expected =
+            links(site, s) * psi(fwd, s) + psi(bck, s);
+        elements_match = elements_match and
+            (result(site, s) - expected).norm() < 1e-12;
+      }
+    }
+    REQUIRE(elements_match);
+
+    // Shifts of expressions and of shifts
+    pyQCD::Lattice<ColourVector> round_trip(layout, 2);
+    round_trip = pyQCD::shift(pyQCD::shift(psi * 2.0, 3, 2), 3, -2);
+    REQUIRE(pyQCD::max_abs(round_trip - psi * 2.0) == 0.0);
+
+    result -= pyQCD::shift(psi, 1, -1);
+    result -= links * pyQCD::shift(psi, 0, 1);
+    REQUIRE(pyQCD::max_abs(result) < 1e-12);
+
+    // Shifts permute the sites, so reductions are unchanged
+    REQUIRE(pyQCD::norm2(pyQCD::shift(psi, 2, 1)) ==
+            Approx(pyQCD::norm2(psi)));
+  }
+
+  SECTION("Testing assignment of shifts to their operand") {
+    // Sites of the target are overwritten while the shift reads them, so
+    // these must be evaluated into a temporary
+    pyQCD::Lattice<ColourVector> expected(layout, 2), aliased(psi);
+    expected = pyQCD::shift(psi, 1, -1) * 2.0 + psi;
+    aliased = pyQCD::shift(aliased, 1, -1) * 2.0 + aliased;
+    REQUIRE(pyQCD::max_abs(aliased - expected) == 0.0);
+
+    expected = psi + pyQCD::shift(psi, 3, 2);
+    aliased = psi;
+    aliased += pyQCD::shift(aliased, 3, 2);
+    REQUIRE(pyQCD::max_abs(aliased - expected) == 0.0);
+  }
+
+  SECTION("Testing invalid shifts") {
+    REQUIRE_THROWS_AS(pyQCD::shift(psi, 4, 1), const std::invalid_argument&);
+    REQUIRE_THROWS_AS(pyQCD::shift(psi, 0, 9), const std::invalid_argument&);
+
+    const pyQCD::CheckerboardLayout even_layout(layout, pyQCD::Parity::Even);
+    pyQCD::Lattice<ColourVector> psi_even(even_layout, 2);
+    REQUIRE_THROWS_AS(pyQCD::shift(psi_even, 1, 1),
+                      const std::invalid_argument&);
+    REQUIRE_THROWS_AS(pyQCD::shift(psi_even, 2, -3),
+                      const std::invalid_argument&);
+    REQUIRE_NOTHROW(pyQCD::shift(psi_even, 1, 2));
+  }
+}
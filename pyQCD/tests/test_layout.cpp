@@ -41,8 +41,25 @@ TEST_CASE("LexicoLayout test") {
   REQUIRE ((layout.shape() == pyQCD::Site{8, 4, 4, 4}));
   REQUIRE (layout.is_even_site(0));
   REQUIRE (layout.is_even_site(pyQCD::Site{2, 0, 1, 1}));
+
+  REQUIRE ((layout.strides() == pyQCD::Site{64, 16, 4, 1}));
+  REQUIRE (layout.shift_site_index(313, 0, 1) == 377);
+  REQUIRE (layout.shift_site_index(313, 1, 1) == 265);
+  REQUIRE (layout.shift_site_index(313, 3, -2) == 315);
+  REQUIRE (layout.shift_site_index(313, 0, -13) == 505);
+
+  for (int i = 0; i < 512; ++i) {
+    auto coords = layout.compute_site_coords(i);
+    for (unsigned int d = 0; d < 4; ++d) {
+      coords[d] = (coords[d] + layout.shape()[d] - 1) % layout.shape()[d];
+      REQUIRE (layout.shift_site_index(i, d, -1) ==
+               layout.get_array_index(coords));
+      coords[d] = (coords[d] + 1) % layout.shape()[d];
+    }
+  }
 }
 
+
 TEST_CASE("EvenOddLayout test") {
   using Layout = pyQCD::EvenOddLayout;
 
@@ -62,6 +79,108 @@ TEST_CASE("EvenOddLayout test") {
 
   REQUIRE (layout.get_array_index(4) == 258);
   REQUIRE (layout.get_site_index(258) == 4);
+
+  SECTION ("Testing shift tables") {
+    for (int disp = 1; disp < 3; ++disp) {
+      const auto& table = layout.shift_table(disp);
+      REQUIRE (table.size() == 2 * 4 * 512);
+
+      bool tables_match = true;
+      for (int site = 0; site < 512; ++site) {
+        const auto arr = layout.get_array_index(site);
+        for (int d = 0; d < 4; ++d) {
+          tables_match = tables_match and
+              table[2 * (4 * arr + d)] ==
+                  layout.get_array_index(
+                      layout.shift_site_index(site, d, disp)) and
+              table[2 * (4 * arr + d) + 1] ==
+                  layout.get_array_index(
+                      layout.shift_site_index(site, d, -disp));
+        }
+      }
+      REQUIRE (tables_match);
+    }
+
+    // Tables are built once and shared between copies of the layout
+    const Layout copy = layout;
+    REQUIRE (&copy.shift_table(2) == &layout.shift_table(2));
+
+    const auto arr = layout.get_array_index(313);
+    REQUIRE (layout.neighbour_array_index(arr, 0, 2) ==
+             layout.get_array_index(layout.shift_site_index(313, 0, 2)));
+    REQUIRE (layout.neighbour_array_index(arr, 3, -3) ==
+             layout.get_array_index(layout.shift_site_index(313, 3, -3)));
+    REQUIRE (layout.neighbour_array_index(arr, 1, 0) == arr);
+
+    REQUIRE_THROWS_AS(layout.shift_table(0), const std::invalid_argument&);
+  }
+}
+
+
+TEST_CASE("VirtualNodeLayout test") {
+  using Layout = pyQCD::VirtualNodeLayout;
+
+  const Layout layout({8, 4, 4, 4}, {2, 1, 1, 2});
+
+  REQUIRE (layout.num_lanes() == 4);
+  REQUIRE ((layout.outer_shape() == pyQCD::Site{4, 4, 4, 2}));
+  REQUIRE (layout.outer_layout().volume() == 128);
+
+  REQUIRE (layout.get_array_index(0) == 0);
+  REQUIRE (layout.get_array_index(pyQCD::Site{0, 0, 0, 2}) == 1);
+  REQUIRE (layout.get_array_index(pyQCD::Site{4, 0, 0, 0}) == 2);
+  REQUIRE (layout.get_array_index(pyQCD::Site{0, 0, 0, 1}) == 4);
+  REQUIRE (layout.get_array_index(347) == 183);
+  REQUIRE (layout.get_site_index(183) == 347);
+
+  for (unsigned int i = 0; i < layout.volume(); ++i) {
+    REQUIRE (layout.get_site_index(layout.get_array_index(i)) == i);
+  }
+
+  REQUIRE_THROWS_AS (Layout({8, 4, 4, 4}, {3, 1, 1, 1}),
+                     const std::invalid_argument&);
+}
+
+
+TEST_CASE("CheckerboardLayout test") {
+  const pyQCD::EvenOddLayout full_layout({8, 4, 4, 4});
+  const pyQCD::CheckerboardLayout layout(full_layout, pyQCD::Parity::Odd);
+  const auto& even_layout = layout.opposite();
+
+  REQUIRE (layout.parity() == pyQCD::Parity::Odd);
+  REQUIRE (even_layout.parity() == pyQCD::Parity::Even);
+  REQUIRE (&even_layout.opposite() == &layout);
+  REQUIRE (&layout.full_layout() == &full_layout);
+  REQUIRE (layout.volume() == 256);
+  REQUIRE (even_layout.volume() == 256);
+  REQUIRE (layout.num_dims() == 4);
+
+  REQUIRE (layout.get_site_index(0) == 1);
+  REQUIRE (even_layout.get_site_index(0) == 0);
+  REQUIRE (even_layout.get_site_index(1) == 2);
+
+  for (unsigned int i = 0; i < layout.volume(); ++i) {
+    REQUIRE (not layout.is_even_site(layout.get_site_index(i)));
+    REQUIRE (even_layout.is_even_site(even_layout.get_site_index(i)));
+    REQUIRE (layout.get_array_index(layout.get_site_index(i)) == i);
+    REQUIRE (even_layout.get_array_index(even_layout.get_site_index(i)) == i);
+  }
+
+  // Odd displacements change parity, so have no neighbours on this layout
+  REQUIRE_THROWS_AS (layout.shift_table(1), const std::invalid_argument&);
+  REQUIRE_THROWS_AS (even_layout.shift_table(3), const std::invalid_argument&);
+
+  const auto& table = even_layout.shift_table(2);
+  for (unsigned int i = 0; i < even_layout.volume(); ++i) {
+    const auto site_index = even_layout.get_site_index(i);
+    for (unsigned int d = 0; d < 4; ++d) {
+      REQUIRE (table[8 * i + 2 * d] < even_layout.volume());
+      REQUIRE (table[8 * i + 2 * d] == even_layout.get_array_index(
+          full_layout.shift_site_index(site_index, d, 2)));
+      REQUIRE (table[8 * i + 2 * d + 1] == even_layout.get_array_index(
+          full_layout.shift_site_index(site_index, d, -2)));
+    }
+  }
 }
 
 
@@ -42,5 +42,80 @@ TEST_CASE("Testing RNG")
   }
   mean /= num_trials;
 
-  REQUIRE(mean == Approx(0.5076074826010093));
-}
\ No newline at end of file
+  REQUIRE(mean == Approx(0.4983036848938878));
+
+  // The largest possible draw must still be below one at any precision
+  REQUIRE(pyQCD::detail::bits_to_unit_real<double>(0xffffffff, 0xffffffff)
+          < 1.0);
+  REQUIRE(pyQCD::detail::bits_to_unit_real<float>(0xffffffff, 0xffffffff)
+          < 1.0f);
+
+  SECTION ("Testing Philox known answers") {
+    // Test vectors from the Random123 distribution
+    using Counter = pyQCD::detail::PhiloxCounter;
+    using Key = pyQCD::detail::PhiloxKey;
+
+    REQUIRE ((pyQCD::detail::philox4x32(Counter{{0, 0, 0, 0}}, Key{{0, 0}}) ==
+              Counter{{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}}));
+    REQUIRE ((pyQCD::detail::philox4x32(
+                  Counter{{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+                  Key{{0xffffffff, 0xffffffff}}) ==
+              Counter{{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}}));
+    REQUIRE ((pyQCD::detail::philox4x32(
+                  Counter{{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}},
+                  Key{{0xa4093822, 0x299f31d0}}) ==
+              Counter{{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}}));
+  }
+
+  SECTION ("Testing streams and bulk generation") {
+    // Generators with the same (seed, stream, sweep) agree, and bulk
+    // generation matches single draws
+    pyQCD::RandGenerator rng1(3, 17, 2), rng2(3, 17, 2), rng3(3, 18, 2);
+    const auto bulk = rng1.generate_reals<double>(101, -1.0, 1.0);
+    REQUIRE (bulk.size() == 101);
+
+    bool draws_match = true, streams_differ = true;
+    for (unsigned int i = 0; i < bulk.size(); ++i) {
+      const auto value = rng2.generate_real<double>(-1.0, 1.0);
+      draws_match = draws_match and value == bulk[i];
+      streams_differ = streams_differ and
+          value != rng3.generate_real<double>(-1.0, 1.0);
+    }
+    REQUIRE (draws_match);
+    REQUIRE (streams_differ);
+
+    const auto gaussians = rng1.generate_gaussians<double>(num_trials, 1.0, 2.0);
+    double gaussian_mean = 0.0, gaussian_var = 0.0;
+    for (const auto value : gaussians) {
+      gaussian_mean += value / num_trials;
+      gaussian_var += (value - 1.0) * (value - 1.0) / num_trials;
+    }
+    REQUIRE (std::abs(gaussian_mean - 1.0) < 0.2);
+    REQUIRE (std::abs(gaussian_var - 4.0) < 0.5);
+  }
+}
+
+TEST_CASE("Testing RandomWrapper")
+{
+  // Shared wrappers are keyed on the exact lattice shape and keep their
+  // addresses as more are created
+  const pyQCD::LexicoLayout layout1({4, 4, 4, 4}), layout2({4, 4, 4, 8});
+  auto& rngs1 = pyQCD::RandomWrapper::instance(layout1);
+  REQUIRE(&pyQCD::RandomWrapper::instance(layout2) != &rngs1);
+
+  for (unsigned int extent = 2; extent < 20; ++extent) {
+    pyQCD::RandomWrapper::instance(pyQCD::LexicoLayout({extent, 2, 2}));
+  }
+  REQUIRE(&pyQCD::RandomWrapper::instance(
+      pyQCD::EvenOddLayout({4, 4, 4, 4})) == &rngs1);
+
+  // Sweep numbers are handed out in order, and a wrapper's generators are
+  // determined by its seed
+  pyQCD::RandomWrapper rngs2(4), rngs3(4);
+  REQUIRE(rngs2.reserve_sweeps(4) == 0);
+  REQUIRE(rngs2.reserve_sweeps() == 4);
+  REQUIRE(rngs2(10, 3).generate_real<double>(0.0, 1.0) ==
+          rngs3(10, 3).generate_real<double>(0.0, 1.0));
+  REQUIRE_THROWS_AS(rngs2.reserve_sweeps(0xffffffff),
+                    const std::overflow_error&);
+}
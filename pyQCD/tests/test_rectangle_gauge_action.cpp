@@ -20,7 +20,10 @@
  * Tests for the Wilson gauge action.
  */
 
+#include <gauge/plaquette.hpp>
+#include <gauge/rectangle.hpp>
 #include <gauge/rectangle_action.hpp>
+#include <utils/matrices.hpp>
 
 #include "helpers.hpp"
 
@@ -85,6 +88,108 @@ TEST_CASE("Test rectangle gauge action")
     }
   }
 
+  SECTION("Testing staples of a random gauge field") {
+    // Each plaquette appears in the staples of its four links and each
+    // rectangle in the staples of its six links
+    const pyQCD::EvenOddLayout layout({4, 4, 4, 4});
+    pyQCD::LatticeColourMatrix<double, 3> gauge_field(layout, 4);
+    pyQCD::RandGenerator rng(5);
+    for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+      gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+    }
+    const Real c1 = -1.0 / 12.0;
+    const pyQCD::gauge::RectangleAction<double, 3> action(5.0, layout, c1);
+
+    Real total = 0.0;
+    for (pyQCD::Int site = 0; site < layout.volume(); ++site) {
+      for (pyQCD::Int mu = 0; mu < 4; ++mu) {
+        const ColourMatrix staple =
+            action.compute_staples(gauge_field, 4 * site + mu);
+        total += (gauge_field(site, mu) * staple).trace().real() / 3.0;
+      }
+    }
+
+    const Real expected =
+        24.0 * layout.volume() * (1.0 - 8.0 * c1) *
+        pyQCD::gauge::average_plaquette(gauge_field) +
+        72.0 * layout.volume() * c1 *
+        pyQCD::gauge::average_rectangle(gauge_field);
+    REQUIRE (total == Approx(expected));
+
+    // Bulk staple computation on a subset of sites should agree with the
+    // link-by-link version and leave the remaining sites untouched
+    std::vector<pyQCD::Int> even_sites;
+    for (pyQCD::Int site = 0; site < layout.volume(); ++site) {
+      if (layout.is_even_site(site)) {
+        even_sites.push_back(site);
+      }
+    }
+    const ColourMatrix zero = ColourMatrix::Zero();
+    pyQCD::LatticeColourMatrix<double, 3> staples(layout, zero, 1);
+    action.compute_all_staples(gauge_field, staples, 2, even_sites);
+
+    bool staples_match = true;
+    for (pyQCD::Int site = 0; site < layout.volume(); ++site) {
+      const ColourMatrix expected_staple =
+          layout.is_even_site(site) ?
+          action.compute_staples(gauge_field, 4 * site + 2) : zero;
+      staples_match = staples_match and staples(site, 0) == expected_staple;
+    }
+    REQUIRE (staples_match);
+
+    REQUIRE_THROWS_AS (action.compute_all_staples(gauge_field, gauge_field, 0),
+                       const std::invalid_argument&);
+  }
+
+  SECTION("Testing plaquette and rectangle averages") {
+    const pyQCD::LexicoLayout layout({6, 4, 4, 2});
+    pyQCD::LatticeColourMatrix<double, 3> gauge_field(layout, 4);
+    pyQCD::RandGenerator rng(7);
+    for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+      gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+    }
+
+    // Compare with sums of the individual loops
+    std::vector<Real> plaq_planes(6, 0.0), rect_planes(6, 0.0);
+    std::vector<Real> plaq_slices(6, 0.0), rect_slices(6, 0.0);
+    for (pyQCD::Int site = 0; site < layout.volume(); ++site) {
+      const auto t = layout.compute_site_coords(site)[0];
+      pyQCD::Int plane = 0;
+      for (pyQCD::Int mu = 0; mu < 4; ++mu) {
+        for (pyQCD::Int nu = mu + 1; nu < 4; ++nu) {
+          const Real plaq = pyQCD::gauge::plaquette(gauge_field, site, mu, nu);
+          const Real rect =
+              pyQCD::gauge::rectangle(gauge_field, site, mu, nu) +
+              pyQCD::gauge::rectangle(gauge_field, site, nu, mu);
+          plaq_planes[plane] += plaq / layout.volume();
+          rect_planes[plane] += rect / (2 * layout.volume());
+          plaq_slices[t] += plaq / (6 * 32);
+          rect_slices[t] += rect / (12 * 32);
+          ++plane;
+        }
+      }
+    }
+
+    const auto plaquettes = pyQCD::gauge::plaquette_averages(gauge_field);
+    const auto rectangles = pyQCD::gauge::rectangle_averages(gauge_field);
+    REQUIRE (plaquettes.planes.size() == 6);
+    REQUIRE (plaquettes.timeslices.size() == 6);
+
+    Real plaq_total = 0.0, rect_total = 0.0;
+    for (unsigned int i = 0; i < 6; ++i) {
+      REQUIRE (plaquettes.planes[i] == Approx(plaq_planes[i]));
+      REQUIRE (rectangles.planes[i] == Approx(rect_planes[i]));
+      REQUIRE (plaquettes.timeslices[i] == Approx(plaq_slices[i]));
+      REQUIRE (rectangles.timeslices[i] == Approx(rect_slices[i]));
+      plaq_total += plaq_planes[i] / 6;
+      rect_total += rect_planes[i] / 6;
+    }
+    REQUIRE (plaquettes.total == Approx(plaq_total));
+    REQUIRE (rectangles.total == Approx(rect_total));
+    REQUIRE (pyQCD::gauge::average_plaquette(gauge_field) ==
+             plaquettes.total);
+  }
+
   SECTION("Testing local action") {
     const Compare<Real> comp(1.0e-8, 1.0e-8);
 
@@ -39,16 +39,14 @@ TEST_CASE("End-to-end heatbath test with rectangle action")
   const pyQCD::gauge::RectangleAction<double, 3> action(4.41, layout,
                                                         -1.0 / 12.0);
 
-  std::vector<std::size_t> seeds(layout.volume(), 0);
-  std::iota(seeds.begin(), seeds.end(), 0);
-  pyQCD::RandomWrapper::instance(layout).set_seeds(seeds);
+  pyQCD::RandomWrapper::instance(layout).set_seed(0);
 
   pyQCD::Heatbath<double, 3> updater(layout, action);
 
   updater.update(gauge_field, 1);
 
   const double plaquette = pyQCD::gauge::average_plaquette(gauge_field);
-  REQUIRE(plaquette == Approx(0.7160328906006762).epsilon(1e-13));
+  REQUIRE(plaquette == Approx(0.712423757188775).epsilon(1e-13));
   const double rectangle = pyQCD::gauge::average_rectangle(gauge_field);
-  REQUIRE(rectangle == Approx(0.547103350169803).epsilon(1e-13));
+  REQUIRE(rectangle == Approx(0.5470882395369586).epsilon(1e-13));
 }
\ No newline at end of file
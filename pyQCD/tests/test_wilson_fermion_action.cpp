@@ -78,4 +78,142 @@ TEST_CASE ("Testing Wilson fermion action")
   eta = wilson_action.apply_full(psi);
 
   REQUIRE (comp(eta[0], expected));
-}
\ No newline at end of file
+}
+
+TEST_CASE ("Testing in-place Wilson fermion operators")
+{
+  using GaugeField = pyQCD::LatticeColourMatrix<double, 3>;
+  using SiteFermion = pyQCD::ColourVector<double, 3>;
+  using FermionField = pyQCD::LatticeColourVector<double, 3>;
+
+  const pyQCD::Site shape{8, 4, 4, 4};
+  const pyQCD::EvenOddLayout layout(shape);
+
+  pyQCD::RandGenerator rng;
+  GaugeField gauge_field(layout, 4);
+  for (unsigned i = 0; i < gauge_field.size(); ++i) {
+    gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+  }
+
+  FermionField psi(layout, 4);
+  for (unsigned i = 0; i < psi.size(); ++i) {
+    for (unsigned c = 0; c < 3; ++c) {
+      psi[i][c] = std::complex<double>(rng.generate_real(-1.0, 1.0),
+                                       rng.generate_real(-1.0, 1.0));
+    }
+  }
+
+  const std::vector<double> boundary_phases{0.5, 0.0, 0.0, 0.0};
+  const pyQCD::fermions::WilsonAction<double, 3> wilson_action(
+      0.1, gauge_field, boundary_phases);
+  const pyQCD::fermions::Action<double, 3>& action = wilson_action;
+
+  const MatrixCompare<SiteFermion> comp(1e-10, 1e-12);
+  FermionField eta(layout, SiteFermion::Zero(), 4);
+
+  SECTION ("Testing full operator") {
+    const auto expected = action.apply_full(psi);
+    action.apply_full(psi, eta);
+
+    for (unsigned i = 0; i < eta.size(); ++i) {
+      REQUIRE (comp(eta[i], expected[i]));
+    }
+  }
+
+  SECTION ("Testing even-odd preconditioned operator") {
+    auto expected = action.apply_odd_odd(psi);
+    expected -= action.apply_odd_even(
+        action.apply_even_even_inv(action.apply_even_odd(psi)));
+    pyQCD::fermions::Workspace<double, 3> workspace;
+    // Apply twice to check that reusing the workspace is harmless
+    action.apply_eoprec(psi, eta, workspace);
+    action.apply_eoprec(psi, eta, workspace);
+
+    for (unsigned i = 0; i < eta.size(); ++i) {
+      REQUIRE (comp(eta[i], expected[i]));
+    }
+  }
+
+  SECTION ("Testing checkerboarded Schur operator") {
+    pyQCD::fermions::Workspace<double, 3> workspace;
+    action.apply_eoprec(psi, eta, workspace);
+
+    const pyQCD::CheckerboardLayout odd_layout(layout, pyQCD::Parity::Odd);
+    FermionField psi_odd(odd_layout, SiteFermion::Zero(), 4);
+    FermionField eta_odd(odd_layout, SiteFermion::Zero(), 4);
+    pyQCD::extract_checkerboard(psi, psi_odd);
+    action.apply_schur(psi_odd, eta_odd, workspace);
+
+    FermionField expected_odd(odd_layout, SiteFermion::Zero(), 4);
+    pyQCD::extract_checkerboard(eta, expected_odd);
+
+    for (unsigned i = 0; i < eta_odd.size(); ++i) {
+      REQUIRE (comp(eta_odd[i], expected_odd[i]));
+    }
+
+    std::vector<FermionField> batch(2, psi_odd);
+    std::vector<FermionField> batch_out(2, eta_odd);
+    action.apply_schur(batch, batch_out, workspace);
+
+    for (unsigned i = 0; i < eta_odd.size(); ++i) {
+      REQUIRE (comp(batch_out[1][i], expected_odd[i]));
+    }
+
+    // Compare the fused hermitian operator with the unfused default
+    wilson_action.Action<double, 3>::apply_schur(psi_odd, expected_odd,
+                                                 workspace);
+    action.apply_hermiticity(expected_odd, expected_odd);
+    action.apply_schur_hermitian(psi_odd, eta_odd, workspace);
+    action.apply_schur_hermitian(batch, batch_out, workspace);
+
+    for (unsigned i = 0; i < eta_odd.size(); ++i) {
+      REQUIRE (comp(eta_odd[i], expected_odd[i]));
+      REQUIRE (comp(batch_out[0][i], expected_odd[i]));
+    }
+
+    REQUIRE_THROWS_AS (action.apply_hopping_checkerboard(psi_odd, eta_odd),
+                       const std::invalid_argument&);
+    REQUIRE_THROWS_AS (action.apply_schur(psi, eta, workspace),
+                       const std::invalid_argument&);
+  }
+
+  SECTION ("Testing aliased in-place operators") {
+    // Only the hermiticity functions may write to their input
+    pyQCD::fermions::Workspace<double, 3> workspace;
+    REQUIRE_THROWS_AS (action.apply_full(psi, psi),
+                       const std::invalid_argument&);
+    REQUIRE_THROWS_AS (action.apply_even_odd(psi, psi),
+                       const std::invalid_argument&);
+    REQUIRE_THROWS_AS (action.apply_eoprec(psi, psi, workspace),
+                       const std::invalid_argument&);
+
+    std::vector<FermionField> batch(2, psi);
+    REQUIRE_THROWS_AS (action.apply_full(batch, batch),
+                       const std::invalid_argument&);
+
+    const pyQCD::CheckerboardLayout odd_layout(layout, pyQCD::Parity::Odd);
+    FermionField psi_odd(odd_layout, SiteFermion::Zero(), 4);
+    pyQCD::extract_checkerboard(psi, psi_odd);
+    REQUIRE_THROWS_AS (action.apply_schur(psi_odd, psi_odd, workspace),
+                       const std::invalid_argument&);
+    REQUIRE_THROWS_AS (wilson_action.Action::apply_schur(
+                           psi_odd, psi_odd, workspace),
+                       const std::invalid_argument&);
+  }
+
+  SECTION ("Testing hermiticity in-place") {
+    const auto expected = action.apply_hermiticity(psi);
+    eta = psi;
+    action.apply_hermiticity(eta, eta);
+
+    for (unsigned i = 0; i < eta.size(); ++i) {
+      REQUIRE (comp(eta[i], expected[i]));
+    }
+
+    action.remove_hermiticity(eta, eta);
+
+    for (unsigned i = 0; i < eta.size(); ++i) {
+      REQUIRE (comp(eta[i], psi[i]));
+    }
+  }
+}
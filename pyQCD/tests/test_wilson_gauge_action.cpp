@@ -20,7 +20,9 @@
  * Tests for the Wilson gauge action.
  */
 
+#include <gauge/plaquette.hpp>
 #include <gauge/wilson_action.hpp>
+#include <utils/matrices.hpp>
 
 #include "helpers.hpp"
 
@@ -57,6 +59,42 @@ TEST_CASE("Test Wilson gauge action")
     REQUIRE (mat_comp(staple, 5.0 * identity + link_product));
   }
 
+  SECTION("Testing staples of a random gauge field") {
+    // Each plaquette appears in the staples of its four links
+    const pyQCD::EvenOddLayout layout({4, 4, 4, 4});
+    pyQCD::LatticeColourMatrix<double, 3> gauge_field(layout, 4);
+    pyQCD::RandGenerator rng(5);
+    for (unsigned int i = 0; i < gauge_field.size(); ++i) {
+      gauge_field[i] = pyQCD::random_sun<double, 3>(rng);
+    }
+    const pyQCD::gauge::WilsonAction<double, 3> action(5.0, layout);
+
+    Real total = 0.0;
+    for (pyQCD::Int site = 0; site < layout.volume(); ++site) {
+      for (pyQCD::Int mu = 0; mu < 4; ++mu) {
+        const ColourMatrix staple =
+            action.compute_staples(gauge_field, 4 * site + mu);
+        total += (gauge_field(site, mu) * staple).trace().real() / 3.0;
+      }
+    }
+
+    REQUIRE (total == Approx(24.0 * layout.volume() *
+                             pyQCD::gauge::average_plaquette(gauge_field)));
+
+    // Bulk staple computation should agree with the link-by-link version
+    pyQCD::LatticeColourMatrix<double, 3> staples(layout, 1);
+    bool staples_match = true;
+    for (pyQCD::Int mu = 0; mu < 4; ++mu) {
+      action.compute_all_staples(gauge_field, staples, mu);
+      for (pyQCD::Int site = 0; site < layout.volume(); ++site) {
+        staples_match = staples_match and
+            staples(site, 0) ==
+                action.compute_staples(gauge_field, 4 * site + mu);
+      }
+    }
+    REQUIRE (staples_match);
+  }
+
   SECTION("Testing local action") {
     const Compare<Real> comp(1.0e-8, 1.0e-8);
 
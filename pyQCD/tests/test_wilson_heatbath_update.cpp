@@ -40,14 +40,39 @@ TEST_CASE("End-to-end heatbath test with Wilson action")
 
   pyQCD::Heatbath<double, 3> updater(layout, action);
 
-  std::vector<std::size_t> seeds(layout.volume(), 0);
-  std::iota(seeds.begin(), seeds.end(), 0);
-  pyQCD::RandomWrapper::instance(layout).set_seeds(seeds);
+  pyQCD::RandomWrapper::instance(layout).set_seed(0);
 
   updater.update(gauge_field, 1);
 
   const double plaquette = pyQCD::gauge::average_plaquette(gauge_field);
-  REQUIRE(plaquette == Approx(0.667267594069949).epsilon(1e-13));
+  REQUIRE(plaquette == Approx(0.6659243884037404).epsilon(1e-13));
   const double rectangle = pyQCD::gauge::average_rectangle(gauge_field);
-  REQUIRE(rectangle == Approx(0.4955249692030583).epsilon(1e-13));
+  REQUIRE(rectangle == Approx(0.5000598966250718).epsilon(1e-13));
+
+  // Independent chains with their own random number contexts
+  pyQCD::RandomWrapper rngs1(0), rngs2(1);
+  GaugeField gauge_field1(layout, GaugeLink::Identity(), 4);
+  GaugeField gauge_field2(layout, GaugeLink::Identity(), 4);
+  pyQCD::Heatbath<double, 3> updater1(layout, action, rngs1);
+  pyQCD::Heatbath<double, 3> updater2(layout, action, rngs2);
+
+  updater1.update(gauge_field1, 1);
+  updater2.update(gauge_field2, 1);
+
+  REQUIRE(pyQCD::gauge::average_plaquette(gauge_field1) == plaquette);
+  REQUIRE(pyQCD::gauge::average_plaquette(gauge_field2) != plaquette);
+
+  // Overrelaxation conserves the Wilson action, so adding overrelaxation
+  // sweeps changes the field but not the average plaquette
+  pyQCD::RandomWrapper rngs3(0);
+  GaugeField gauge_field3(layout, GaugeLink::Identity(), 4);
+  pyQCD::Heatbath<double, 3> updater3(layout, action, rngs3);
+  REQUIRE(updater3.num_overrelaxation_steps() == 0);
+  updater3.set_num_overrelaxation_steps(2);
+
+  updater3.update(gauge_field3, 1);
+
+  REQUIRE(pyQCD::gauge::average_plaquette(gauge_field3) ==
+          Approx(plaquette).epsilon(1e-12));
+  REQUIRE(not gauge_field3[0].isApprox(gauge_field1[0]));
 }
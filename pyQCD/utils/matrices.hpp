@@ -23,6 +23,8 @@
  */
 
 #include <array>
+#include <cmath>
+#include <limits>
 
 #include <core/qcd_types.hpp>
 #include <utils/math.hpp>
@@ -143,10 +145,107 @@ namespace pyQCD {
     return ret;
   }
 
+  // Compressed representations of SU(3) matrices. These rely on the
+  // unitarity of the matrix, so they shouldn't be used for general colour
+  // matrices.
+
+  template <typename Real>
+  void compress_su3_12(const ColourMatrix<Real, 3>& matrix, Real* data)
+  {
+    // Store the first two rows of the matrix as 12 reals.
+    for (int i = 0; i < 2; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        data[6 * i + 2 * j] = matrix(i, j).real();
+        data[6 * i + 2 * j + 1] = matrix(i, j).imag();
+      }
+    }
+  }
+
+  template <typename Real>
+  ColourMatrix<Real, 3> reconstruct_su3_12(const Real* data)
+  {
+    // Rebuild the third row from the first two, using the fact that for an
+    // SU(3) matrix it's the complex conjugate of their cross product.
+    ColourMatrix<Real, 3> ret;
+    for (int i = 0; i < 2; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        ret(i, j) = std::complex<Real>(data[6 * i + 2 * j],
+                                       data[6 * i + 2 * j + 1]);
+      }
+    }
+
+    ret(2, 0) = std::conj(ret(0, 1) * ret(1, 2) - ret(0, 2) * ret(1, 1));
+    ret(2, 1) = std::conj(ret(0, 2) * ret(1, 0) - ret(0, 0) * ret(1, 2));
+    ret(2, 2) = std::conj(ret(0, 0) * ret(1, 1) - ret(0, 1) * ret(1, 0));
+
+    return ret;
+  }
+
+  template <typename Real>
+  void compress_su3_8(const ColourMatrix<Real, 3>& matrix, Real* data)
+  {
+    // Store the matrix using eight reals: U_01, U_02 and U_10 as complex
+    // numbers, followed by the phases of U_00 and U_20.
+    data[0] = matrix(0, 1).real();
+    data[1] = matrix(0, 1).imag();
+    data[2] = matrix(0, 2).real();
+    data[3] = matrix(0, 2).imag();
+    data[4] = matrix(1, 0).real();
+    data[5] = matrix(1, 0).imag();
+    data[6] = std::arg(matrix(0, 0));
+    data[7] = std::arg(matrix(2, 0));
+  }
+
+  template <typename Real>
+  bool can_compress_su3_8(const ColourMatrix<Real, 3>& matrix)
+  {
+    // The eight real representation can't be inverted accurately when
+    // |U_01|^2 + |U_02|^2 is small, since the second and third rows are then
+    // no longer determined by the stored parameters. The reconstruction
+    // error is roughly epsilon / (|U_01|^2 + |U_02|^2).
+    const Real norm = std::norm(matrix(0, 1)) + std::norm(matrix(0, 2));
+    return norm >= std::sqrt(std::numeric_limits<Real>::epsilon());
+  }
+
+  template <typename Real>
+  ColourMatrix<Real, 3> reconstruct_su3_8(const Real* data)
+  {
+    // Inverse of compress_su3_8. The magnitudes of U_00 and U_20 follow from
+    // the normalisation of the first row and column, after which the
+    // remaining elements of the second and third rows are fixed by unitarity.
+    // This is singular when |U_00| = 1 (e.g. for the identity), so
+    // can_compress_su3_8 should be checked before compressing.
+    const std::complex<Real> a2(data[0], data[1]);
+    const std::complex<Real> a3(data[2], data[3]);
+    const std::complex<Real> b1(data[4], data[5]);
+
+    const Real norm = std::norm(a2) + std::norm(a3);
+    const Real a1_mod = std::sqrt(std::max(Real(1) - norm, Real(0)));
+    const Real c1_mod = std::sqrt(std::max(norm - std::norm(b1), Real(0)));
+    const std::complex<Real> a1 = std::polar(a1_mod, data[6]);
+    const std::complex<Real> c1 = std::polar(c1_mod, data[7]);
+
+    const Real inv_norm = Real(1) / norm;
+
+    ColourMatrix<Real, 3> ret;
+    ret(0, 0) = a1;
+    ret(0, 1) = a2;
+    ret(0, 2) = a3;
+    ret(1, 0) = b1;
+    ret(2, 0) = c1;
+    ret(1, 1) = -(std::conj(a1) * b1 * a2 + std::conj(a3 * c1)) * inv_norm;
+    ret(1, 2) = (std::conj(a2 * c1) - std::conj(a1) * b1 * a3) * inv_norm;
+    ret(2, 1) = (std::conj(a3 * b1) - std::conj(a1) * c1 * a2) * inv_norm;
+    ret(2, 2) = -(std::conj(a2 * b1) + std::conj(a1) * c1 * a3) * inv_norm;
+
+    return ret;
+  }
+
   template <typename Real>
   std::vector<SpinMatrix<Real>> generate_gamma_matrices(const int num_dims)
   {
     using Mat = SpinMatrix<Real>;
+    using Scalar = std::complex<Real>;
     const auto mat_size = static_cast<unsigned int>(std::pow(2.0, num_dims / 2));
 
     if (num_dims < 2) {
@@ -154,10 +253,11 @@ namespace pyQCD {
                                  "generate_gamma_matrices");
     }
     else if (num_dims == 2) {
-      return std::vector<Mat>{sigma1, sigma2};
+      return std::vector<Mat>{sigma1.cast<Scalar>(), sigma2.cast<Scalar>()};
     }
     else if (num_dims == 3) {
-      return std::vector<Mat>{sigma1, sigma2, sigma3};
+      return std::vector<Mat>{sigma1.cast<Scalar>(), sigma2.cast<Scalar>(),
+                              sigma3.cast<Scalar>()};
     }
     else if (num_dims % 2 == 0) {
       const auto sub_matrices = generate_gamma_matrices<Real>(num_dims - 1);
@@ -165,9 +265,9 @@ namespace pyQCD {
 
       for (int i = 1; i < num_dims; ++i) {
         ret[i].block(0, mat_size / 2, mat_size / 2, mat_size / 2)
-            = -I * sub_matrices[i - 1];
+            = -Scalar(I) * sub_matrices[i - 1];
         ret[i].block(mat_size / 2, 0, mat_size / 2, mat_size / 2)
-            = I * sub_matrices[i - 1];
+            = Scalar(I) * sub_matrices[i - 1];
       }
       ret.front().block(0, mat_size / 2, mat_size / 2, mat_size / 2)
           = Mat::Identity(mat_size / 2, mat_size / 2);
@@ -17,50 +17,48 @@
  * Created by Matt Spraggs on 10/02/16.
  */
 
-#include <unordered_map>
-#include <vector>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 
 #include "random.hpp"
 
 
 namespace pyQCD {
-  RandomWrapper::RandomWrapper(const std::size_t num_rngs)
-  {
-    // Initialise the specified number of RandGenerators
-    rngs_.reserve(num_rngs);
-
-    std::random_device rd;
-    for (std::size_t i = 0; i < num_rngs; ++i) {
-      rngs_.emplace_back(rd());
-    }
-  }
-
   RandomWrapper& RandomWrapper::instance(const Layout& layout)
   {
-    // RandomWrapper should be a singleton.
-    static std::unordered_map<unsigned int, std::size_t> map;
-    static std::vector<RandomWrapper> rngs;
+    // Returns the RandomWrapper shared between lattices with the same shape.
+    // Wrappers are never destroyed or moved, so references remain valid.
+    static std::mutex mutex;
+    static std::map<Site, std::unique_ptr<RandomWrapper>> registry;
 
-    // Create a lattice-shape specific hash
-    const auto& shape = layout.shape();
-    auto hash = static_cast<unsigned int>(shape.size());
-    for (auto extent : shape) {
-      hash ^= extent + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& rngs = registry[layout.shape()];
+    if (not rngs) {
+      rngs.reset(new RandomWrapper(detail::random_seed()));
     }
 
-    if (map.count(hash) == 0) {
-      rngs.push_back(RandomWrapper(layout.volume()));
-      map[hash] = rngs.size() - 1;
-    }
+    return *rngs;
+  }
 
-    return rngs[map[hash]];
+  void RandomWrapper::set_seed(const std::size_t seed)
+  {
+    // Restart the sequence of sweeps with the new seed
+    seed_ = seed;
+    next_sweep_ = 0;
   }
 
-  void RandomWrapper::set_seeds(const std::vector<std::size_t>& seeds)
+  std::uint32_t RandomWrapper::reserve_sweeps(const std::uint32_t num)
   {
-    for (std::size_t i = 0; i < rngs_.size(); ++i) {
-      rngs_[i].set_seed(seeds.at(i));
-    }
+    auto first = next_sweep_.load();
+    do {
+      if (num > std::numeric_limits<std::uint32_t>::max() - first) {
+        throw std::overflow_error("Random number sweep counter exhausted");
+      }
+    } while (not next_sweep_.compare_exchange_weak(first, first + num));
+    return first;
   }
 
 
@@ -20,23 +20,120 @@
  *
  *
  * This file contains the random number generator used by the rest of the code.
+ *
+ * Random numbers are generated with the Philox4x32-10 counter-based generator
+ * of Salmon et al. (2011), "Parallel random numbers: as easy as 1, 2, 3".
+ * Each block of four 32-bit outputs is a bijective function of a 128-bit
+ * counter and a 64-bit key, so a generator needs no state beyond its
+ * position in the stream. Here the key is the seed, and the counter is made
+ * up of a stream index (e.g. a lattice site), a sweep number and the number
+ * of blocks drawn so far. Generators for any (seed, stream, sweep) can
+ * therefore be created on demand and in any order, and produce the same
+ * numbers regardless of the number of threads or the lattice layout.
  */
 
-#include <chrono>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <random>
 #include <vector>
 
 #include <core/layout.hpp>
+#include <utils/math.hpp>
 
 
-// TODO: Adjust this to put an RNG on each site.
-
 namespace pyQCD {
+  namespace detail
+  {
+    using PhiloxCounter = std::array<std::uint32_t, 4>;
+    using PhiloxKey = std::array<std::uint32_t, 2>;
+
+    inline void philox_rounds(std::uint32_t& c0, std::uint32_t& c1,
+                              std::uint32_t& c2, std::uint32_t& c3,
+                              std::uint32_t k0, std::uint32_t k1)
+    {
+      // Ten rounds of the Philox bijection, applied in place to the counter
+      // (c0, c1, c2, c3) with key (k0, k1)
+      for (unsigned int round = 0; round < 10; ++round) {
+        const std::uint64_t prod0 = static_cast<std::uint64_t>(0xD2511F53) * c0;
+        const std::uint64_t prod1 = static_cast<std::uint64_t>(0xCD9E8D57) * c2;
+        c0 = static_cast<std::uint32_t>(prod1 >> 32) ^ c1 ^ k0;
+        c2 = static_cast<std::uint32_t>(prod0 >> 32) ^ c3 ^ k1;
+        c1 = static_cast<std::uint32_t>(prod1);
+        c3 = static_cast<std::uint32_t>(prod0);
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+      }
+    }
+
+    inline PhiloxCounter philox4x32(const PhiloxCounter& counter,
+                                    const PhiloxKey& key)
+    {
+      PhiloxCounter ret = counter;
+      philox_rounds(ret[0], ret[1], ret[2], ret[3], key[0], key[1]);
+      return ret;
+    }
+
+    inline void philox4x32_blocks(const PhiloxCounter& counter,
+                                  const PhiloxKey& key,
+                                  const std::size_t num_blocks,
+                                  std::uint32_t* words)
+    {
+      // Generate num_blocks consecutive blocks, starting at counter. Word i
+      // of block n is stored in words[i * num_blocks + n], so that the
+      // blocks can be generated in parallel by SIMD instructions. The
+      // counter and key are copied so the compiler knows that writes to words
+      // don't modify them.
+      const PhiloxCounter start = counter;
+      const PhiloxKey block_key = key;
+
+      for (std::size_t block = 0; block < num_blocks; ++block) {
+        std::uint32_t c0 = start[0] + static_cast<std::uint32_t>(block);
+        std::uint32_t c1 = start[1], c2 = start[2], c3 = start[3];
+        philox_rounds(c0, c1, c2, c3, block_key[0], block_key[1]);
+        words[block] = c0;
+        words[num_blocks + block] = c1;
+        words[2 * num_blocks + block] = c2;
+        words[3 * num_blocks + block] = c3;
+      }
+    }
+
+    inline std::uint64_t random_seed()
+    {
+      // Non-deterministic 64-bit seed, combining two draws from
+      // std::random_device, which only returns 32 bits at a time
+      std::random_device rd;
+      const std::uint64_t high = rd();
+      return (high << 32) ^ rd();
+    }
+
+    template <typename Real>
+    Real bits_to_unit_real(const std::uint32_t high, const std::uint32_t low)
+    {
+      // Map 53 random bits onto [0, 1)
+      const std::uint64_t bits =
+          ((static_cast<std::uint64_t>(high) << 32) | low) >> 11;
+      return static_cast<Real>(bits * (1.0 / 9007199254740992.0));
+    }
+
+    template <>
+    inline float bits_to_unit_real<float>(const std::uint32_t high,
+                                          const std::uint32_t)
+    {
+      // Rounding 53 bits to a float can give 1.0f, so only use as many bits
+      // as a float's mantissa holds
+      return static_cast<float>(high >> 8) * (1.0f / 16777216.0f);
+    }
+  }
+
+
   class RandGenerator
   {
   public:
-    RandGenerator() : RandGenerator(std::random_device()()) {}
-    RandGenerator(const std::size_t seed) : engine_(seed) {}
+    RandGenerator() : RandGenerator(detail::random_seed()) {}
+    RandGenerator(const std::size_t seed, const std::size_t stream = 0,
+                  const std::uint32_t sweep = 0);
 
     template <typename Real>
     Real generate_real(const Real lower, const Real upper);
@@ -44,47 +141,182 @@ namespace pyQCD {
     template <typename Int>
     Int generate_int(const Int lower, const Int upper);
 
-    void set_seed(const std::size_t seed) { engine_.seed(seed); }
+    // Bulk generation of uniform reals in [lower, upper) and of normally
+    // distributed reals. These start at the next unbuffered block of the
+    // stream, discarding any buffered words not yet used by single draws.
+    template <typename Real>
+    std::vector<Real> generate_reals(const std::size_t num, const Real lower,
+                                     const Real upper);
+
+    template <typename Real>
+    std::vector<Real> generate_gaussians(const std::size_t num,
+                                         const Real mean, const Real stddev);
+
+    void set_seed(const std::size_t seed);
+
   private:
-    std::mt19937_64 engine_;
+    std::uint32_t next_word();
+
+    // Number of blocks generated at once for single draws
+    static constexpr unsigned int num_buffered_blocks = 8;
+    static constexpr unsigned int buffer_size = 4 * num_buffered_blocks;
+
+    detail::PhiloxKey key_;
+    // Counter words are (block, sweep, stream low, stream high)
+    detail::PhiloxCounter counter_;
+    // Buffered blocks, in the layout used by detail::philox4x32_blocks
+    std::array<std::uint32_t, buffer_size> buffer_;
+    unsigned int num_used_;
   };
 
 
   class RandomWrapper
   {
+    // Source of per-site random number generators, used as the random
+    // number context of a Markov chain. Rather than storing a generator for
+    // each site, generators are created on demand from the seed, the site
+    // index and a sweep number. Each sweep number should be used at most once
+    // per site, so callers reserve sweep numbers before creating generators.
+    //
+    // Independent chains should each use their own RandomWrapper. The
+    // wrapper returned by instance() is shared by every caller using a
+    // lattice of the given shape.
   public:
+    RandomWrapper() : RandomWrapper(detail::random_seed()) {}
+    explicit RandomWrapper(const std::size_t seed)
+      : seed_(seed), next_sweep_(0)
+    {}
+    // Copies would produce the same random numbers as the original
+    RandomWrapper(const RandomWrapper&) = delete;
+    RandomWrapper& operator=(const RandomWrapper&) = delete;
+
     static RandomWrapper& instance(const Layout& layout);
 
-    void set_seeds(const std::vector<std::size_t>& seeds);
+    // Not thread safe, so should not be called while generators are in use
+    void set_seed(const std::size_t seed);
+    std::size_t seed() const { return seed_; }
 
-    RandGenerator& operator[](const std::size_t index) { return rngs_[index]; }
-    const RandGenerator& operator[](const std::size_t index) const
-    { return rngs_[index]; }
+    // Reserve num consecutive sweep numbers, returning the first. This is
+    // thread safe, so a wrapper can be shared between threads.
+    std::uint32_t reserve_sweeps(const std::uint32_t num = 1);
 
-  private:
-    RandomWrapper(const std::size_t num_rngs);
+    RandGenerator operator()(const std::size_t site,
+                             const std::uint32_t sweep) const
+    { return RandGenerator(seed_, site, sweep); }
 
-    std::vector<RandGenerator> rngs_;
+  private:
+    std::size_t seed_;
+    std::atomic<std::uint32_t> next_sweep_;
   };
 
 
+  inline RandGenerator::RandGenerator(const std::size_t seed,
+                                      const std::size_t stream,
+                                      const std::uint32_t sweep)
+    : counter_{{0, sweep, static_cast<std::uint32_t>(stream),
+                static_cast<std::uint32_t>(
+                    static_cast<std::uint64_t>(stream) >> 32)}},
+      num_used_(buffer_size)
+  {
+    key_ = detail::PhiloxKey{{
+        static_cast<std::uint32_t>(seed),
+        static_cast<std::uint32_t>(static_cast<std::uint64_t>(seed) >> 32)}};
+  }
+
+
+  inline void RandGenerator::set_seed(const std::size_t seed)
+  {
+    // Restart the current stream with the new seed
+    key_ = detail::PhiloxKey{{
+        static_cast<std::uint32_t>(seed),
+        static_cast<std::uint32_t>(static_cast<std::uint64_t>(seed) >> 32)}};
+    counter_[0] = 0;
+    num_used_ = buffer_size;
+  }
+
+
+  inline std::uint32_t RandGenerator::next_word()
+  {
+    if (num_used_ == buffer_size) {
+      detail::philox4x32_blocks(counter_, key_, num_buffered_blocks,
+                                buffer_.data());
+      counter_[0] += num_buffered_blocks;
+      num_used_ = 0;
+    }
+    // Words are returned in stream order, i.e. block by block
+    const unsigned int block = num_used_ / 4;
+    const unsigned int word = num_used_ % 4;
+    ++num_used_;
+    return buffer_[num_buffered_blocks * word + block];
+  }
+
+
   template<typename Real>
   Real RandGenerator::generate_real(const Real lower, const Real upper)
   {
-    std::uniform_real_distribution<Real> dist(lower, upper);
-    return dist(engine_);
+    const std::uint32_t high = next_word();
+    const std::uint32_t low = next_word();
+    return lower + (upper - lower) * detail::bits_to_unit_real<Real>(high, low);
   }
 
 
   template <typename Int>
   Int RandGenerator::generate_int(const Int lower, const Int upper)
   {
-    std::uniform_int_distribution<int> dist(lower, upper);
-    return dist(engine_);
+    // The bias from the modulus is at most 2^-32 for ranges of 32-bit size
+    const std::uint64_t range = static_cast<std::uint64_t>(upper - lower) + 1;
+    const std::uint64_t high = next_word();
+    const std::uint64_t bits = (high << 32) | next_word();
+    return lower + static_cast<Int>(bits % range);
+  }
+
+
+  template <typename Real>
+  std::vector<Real> RandGenerator::generate_reals(
+      const std::size_t num, const Real lower, const Real upper)
+  {
+    // Each block gives two reals
+    std::vector<Real> ret(num + num % 2);
+    const std::size_t num_blocks = ret.size() / 2;
+    const Real scale = upper - lower;
+
+    std::vector<std::uint32_t> words(4 * num_blocks);
+    detail::philox4x32_blocks(counter_, key_, num_blocks, words.data());
+
+    for (std::size_t block = 0; block < num_blocks; ++block) {
+      ret[2 * block] = lower + scale * detail::bits_to_unit_real<Real>(
+          words[block], words[num_blocks + block]);
+      ret[2 * block + 1] = lower + scale * detail::bits_to_unit_real<Real>(
+          words[2 * num_blocks + block], words[3 * num_blocks + block]);
+    }
+
+    counter_[0] += static_cast<std::uint32_t>(num_blocks);
+    num_used_ = buffer_size;
+    ret.resize(num);
+    return ret;
+  }
+
+
+  template <typename Real>
+  std::vector<Real> RandGenerator::generate_gaussians(
+      const std::size_t num, const Real mean, const Real stddev)
+  {
+    // Box-Muller transform of pairs of uniform reals
+    auto ret = generate_reals<Real>(num + num % 2, 0.0, 1.0);
+
+    for (std::size_t i = 0; i < ret.size(); i += 2) {
+      const Real radius = stddev * std::sqrt(-2 * std::log(1 - ret[i]));
+      const Real angle = 2 * pi * ret[i + 1];
+      ret[i] = mean + radius * std::cos(angle);
+      ret[i + 1] = mean + radius * std::sin(angle);
+    }
+
+    ret.resize(num);
+    return ret;
   }
 
 
   RandomWrapper& rng(const Layout& layout);
 }
 
-#endif
\ No newline at end of file
+#endif